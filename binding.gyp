@@ -10,13 +10,24 @@
         'src/win32ole_gettimeofday.cc',
         'src/force_gc_extension.cc',
         'src/force_gc_internal.cc',
+        'src/win32ole_stats.cc',
+        'src/win32ole_options.cc',
+        'src/win32ole_bindings.cc',
         'src/client.cc',
         'src/v8variant.cc',
         'src/v8dispatch.cc',
         'src/v8dispmember.cc',
         'src/v8dispmethod.cc',
         'src/v8dispidxprop.cc',
-        'src/ole32core.cpp'
+        'src/v8dispasync.cc',
+        'src/v8disppath.cc',
+        'src/ole32core.cpp',
+        'src/oletypeinfo.cpp',
+        'src/oletypeindex.cpp',
+        'src/olevtable.cpp',
+        'src/oleapartment.cpp',
+        'src/olememberpath.cpp',
+        'src/oledate.cpp'
       ],
       'dependencies': [
       ]
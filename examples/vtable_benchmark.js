@@ -0,0 +1,38 @@
+var win32ole = require('win32ole');
+win32ole.print('vtable_benchmark\n');
+
+// Scripting.FileSystemObject and Scripting.Dictionary are dual interfaces served in-process by scrrun.dll,
+// so the same calls can be timed through IDispatch::Invoke and through the vtable
+var COUNT = 100000;
+
+var time = function(title, callback){
+  var start = process.hrtime();
+  for(var i = 0; i < COUNT; ++i) callback(i);
+  var elapsed = process.hrtime(start);
+  var ms = elapsed[0] * 1e3 + elapsed[1] / 1e6;
+  console.log('  ' + title + ': ' + ms.toFixed(1) + ' ms (' + (ms * 1e3 / COUNT).toFixed(2) + ' us/call)');
+};
+
+var vtable_benchmark = function(){
+  [false, true].forEach(function(vtableCalls){
+    win32ole.option('vtableCalls', vtableCalls);
+    var f = new ActiveXObject('Scripting.FileSystemObject');
+    var d = new ActiveXObject('Scripting.Dictionary'); // kept empty, CompareMode can't change once it has items
+    console.log(vtableCalls ? 'vtable:' : 'IDispatch::Invoke:');
+    // results have to be the same either way
+    if(f.BuildPath('C:\\tmp', 'a.txt') !== 'C:\\tmp\\a.txt') throw new Error('unexpected BuildPath result');
+    time('FileSystemObject.BuildPath(string, string)', function(i){ f.BuildPath('C:\\tmp', 'file' + i); });
+    time('FileSystemObject.GetExtensionName(string)', function(i){ f.GetExtensionName('file.txt'); });
+    time('Dictionary.Count', function(i){ d.Count; });
+    time('Dictionary.CompareMode = 1', function(i){ d.CompareMode = 1; });
+    d.Finalize();
+    f.Finalize();
+  });
+  win32ole.option('vtableCalls', false);
+};
+
+try{
+  vtable_benchmark();
+}catch(e){
+  console.log('*** exception cached ***\n' + e);
+}
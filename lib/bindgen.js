@@ -0,0 +1,97 @@
+/*
+  bindgen.js
+  Generates a module with the DISPIDs, invoke kinds and argument types of a type library baked in.
+  Calls through it go straight to win32ole.invoke, skipping the named property lookup.
+
+  node lib/bindgen.js <type library path | ProgID> [output.js]
+
+  For every dispinterface the module exports an object of accessors taking the target as first argument:
+    var excel = require('./excel_bindings');
+    excel.Range.put_Value(range, undefined, 42); // optional arguments may be left undefined
+    var v = excel.Range.get_Value(range);
+    excel.Range.Activate(range);
+*/
+
+var fs = require('fs');
+var path = require('path');
+var win32ole = require('./win32ole');
+
+var DISPATCH_METHOD = 1, DISPATCH_PROPERTYGET = 2,
+  DISPATCH_PROPERTYPUT = 4, DISPATCH_PROPERTYPUTREF = 8;
+
+var prefixes = {};
+prefixes[DISPATCH_METHOD] = '';
+prefixes[DISPATCH_PROPERTYGET] = 'get_';
+prefixes[DISPATCH_PROPERTYPUT] = 'put_';
+prefixes[DISPATCH_PROPERTYPUTREF] = 'putref_';
+
+var reserved = ('break case catch class const continue debugger default delete do else enum export extends ' +
+  'false finally for function if implements import in instanceof interface let new null package private ' +
+  'protected public return self static super switch this throw true try typeof var void while with yield ' +
+  'arguments eval undefined').split(' ');
+
+function identifier(name){
+  if(!/^[A-Za-z_$][\w$]*$/.test(name)) name = name.replace(/[^\w$]/g, '_').replace(/^(\d)/, '_$1');
+  return reserved.indexOf(name) >= 0 ? name + '_' : name;
+}
+
+function generateMember(member){
+  var params = ['self'], used = { self: true }, vts = [];
+  member.params.forEach(function(param){
+    var name = identifier(param.name);
+    while(used[name]) name += '_';
+    used[name] = true;
+    params.push(name);
+    vts.push(param.vt);
+  });
+  // the types are passed even if they are all VARIANT, so arguments left undefined are sent as missing
+  var args = ['self', member.dispid < 0 ? String(member.dispid) : '0x' + member.dispid.toString(16), member.invkind];
+  args.push(vts.length ? '[' + vts.join(', ') + ']' : 'null');
+  args = args.concat(params.slice(1));
+  var key = prefixes[member.invkind] + member.name;
+  if(!/^[A-Za-z_$][\w$]*$/.test(key)) key = JSON.stringify(key);
+  return '  ' + key + ': function(' + params.join(', ') + '){ return invoke(' + args.join(', ') + '); }';
+}
+
+exports.generate = function(library){
+  var lines = [];
+  lines.push('// Generated by win32ole/lib/bindgen.js from ' + library.name + ' ' +
+    library.guid + ' ' + library.major + '.' + library.minor + ', do not edit.');
+  lines.push("var invoke = require('win32ole').invoke;");
+  library.types.forEach(function(type){
+    var seen = {};
+    var members = type.members.filter(function(member){
+      var key = (prefixes[member.invkind] + member.name).toLowerCase();
+      if(seen[key]) return false;
+      return seen[key] = true;
+    });
+    lines.push('');
+    lines.push('// ' + type.guid + (type.dual ? ' (dual)' : ''));
+    lines.push('exports.' + identifier(type.name) + ' = {');
+    lines.push(members.map(generateMember).join(',\n'));
+    lines.push('};');
+  });
+  return lines.join('\n') + '\n';
+};
+
+// path of a type library, or a ProgID whose object is created to ask for its library
+exports.describe = function(spec){
+  if(/[\\\/]/.test(spec) || /\.(tlb|olb|dll|exe|ocx)$/i.test(spec)) return win32ole.typeLibrary(spec);
+  var obj = win32ole.client.Dispatch(spec);
+  try{
+    return win32ole.typeLibrary(obj);
+  }finally{
+    obj.Finalize();
+  }
+};
+
+if(require.main === module){
+  var args = process.argv.slice(2);
+  if(!args.length){
+    console.log('usage: node ' + path.basename(process.argv[1]) + ' <type library path | ProgID> [output.js]');
+    process.exit(1);
+  }
+  var source = exports.generate(exports.describe(args[0]));
+  if(args[1]) fs.writeFileSync(args[1], source, 'utf8');
+  else process.stdout.write(source);
+}
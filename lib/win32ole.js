@@ -71,6 +71,12 @@ win32ole.vt_names = (function(){
   return names;
 })();
 
+// invoke kinds for win32ole.invoke and win32ole.batch
+win32ole.dispatch_enum = {
+  DISPATCH_METHOD: 1, DISPATCH_PROPERTYGET: 2,
+  DISPATCH_PROPERTYPUT: 4, DISPATCH_PROPERTYPUTREF: 8
+};
+
 function subclass(constructor, superConstructor)
 { // from http://www.golimojo.com/etc/js-subclass.html
   function surrogateConstructor() { }
@@ -3,6 +3,7 @@
 */
 
 #include "client.h"
+#include "v8dispasync.h"
 #include "v8dispatch.h"
 #include "v8variant.h"
 
@@ -13,6 +14,73 @@ namespace node_win32ole {
 
 Nan::Persistent<FunctionTemplate> Client::clazz;
 
+namespace {
+
+// When 'CoInitialize(NULL)' is not called first (and on the same instance),
+// next functions will return many errors.
+// (old style) GetActiveObject() returns 0x000036b7
+//   The requested lookup key was not found in any active activation context.
+// (OLE2) CoCreateInstance() returns 0x000003f0
+//   An attempt was made to reference a token that does not exist.
+// C -> C++ changes types (&clsid -> clsid, &IID_IDispatch -> IID_IDispatch)
+// options (CLSCTX_INPROC_SERVER CLSCTX_INPROC_HANDLER CLSCTX_LOCAL_SERVER)
+HRESULT CreateDispatch(const CLSID& clsid, IDispatch** ppDisp)
+{
+  DWORD ctx = CLSCTX_INPROC_SERVER|CLSCTX_LOCAL_SERVER;
+  HRESULT hr = CoCreateInstance(clsid, NULL, ctx, IID_IDispatch, (void **)ppDisp);
+  if(FAILED(hr)){
+    // Retry with WOW6432 bridge option.
+    // This may not be a right way, but better.
+    BDISPFUNCDAT("FAILED CoCreateInstance: %d: 0x%08x\n", 0, hr);
+#if defined(_WIN64)
+    ctx |= CLSCTX_ACTIVATE_32_BIT_SERVER; // 32bit COM server on 64bit OS
+#else
+    ctx |= CLSCTX_ACTIVATE_64_BIT_SERVER; // 64bit COM server on 32bit OS
+#endif
+    hr = CoCreateInstance(clsid, NULL, ctx, IID_IDispatch, (void **)ppDisp);
+  }
+  return hr;
+}
+
+// creates the object on another apartment's thread and leaves it in the global interface table
+class CreateTask : public OCTask
+{
+public:
+  CreateTask(const CLSID& c) : clsid(c), hr(S_OK), ref(NULL) {}
+  virtual void run()
+  {
+    IDispatch* disp = NULL;
+    hr = CreateDispatch(clsid, &disp);
+    if (FAILED(hr)) return;
+    hr = OCGlobalRef::create(disp, IID_IDispatch, &ref);
+    disp->Release(); // the table keeps it alive until node has its proxy
+  }
+  virtual void complete() {}
+  CLSID clsid;
+  HRESULT hr;
+  OCGlobalRef* ref;
+};
+
+enum EApartmentKind { ak_Main = 0, ak_Pool, ak_Mta };
+const char* apartmentKinds[] = { "main", "pool", "mta" };
+
+bool ParseApartmentKind(Local<Value> value, int* kind)
+{
+  if (!value->IsString()) return false;
+  String::Utf8Value u8s(value);
+  for (int i = 0; i < (int)(sizeof(apartmentKinds) / sizeof(apartmentKinds[0])); ++i)
+  {
+    if (!strcmp(*u8s, apartmentKinds[i]))
+    {
+      *kind = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
 void Client::Init(Nan::ADDON_REGISTER_FUNCTION_ARGS_TYPE target)
 {
   Nan::HandleScope scope;
@@ -32,16 +100,27 @@ NAN_METHOD(Client::New)
   if(!info.IsConstructCall())
     return Nan::ThrowError("Use the new operator to create new Client objects");
   std::string cstr_locale(".ACP"); // default
-  if(info.Length() >= 1){
+  if(info.Length() >= 1 && !info[0]->IsUndefined()){
     if(!info[0]->IsString())
       return Nan::ThrowTypeError("Argument 1 is not a String");
     String::Utf8Value u8s_locale(info[0]);
     cstr_locale = std::string(*u8s_locale);
   }
+  int apartmentKind = ak_Main;
+  if (info.Length() >= 2 && info[1]->IsObject())
+  {
+    Local<Value> vApartment;
+    if (GET_PROP(Local<Object>::Cast(info[1]), "apartment").ToLocal(&vApartment) && !vApartment->IsUndefined()
+      && !ParseApartmentKind(vApartment, &apartmentKind))
+    {
+      return Nan::ThrowTypeError("apartment must be 'main', 'pool' or 'mta'");
+    }
+  }
   Local<Object> thisObject = info.This();
   Client *cl = new Client(); // must catch exception
   if (!cl)
     return Nan::ThrowError("Can't create new Client object (null OLE32core)");
+  cl->apartmentKind = apartmentKind;
   cl->Wrap(thisObject); // InternalField[0]
   HRESULT cnresult = cl->oc.connect(cstr_locale);
   if (FAILED(cnresult))
@@ -65,6 +144,27 @@ NAN_METHOD(Client::Dispatch)
     wcs = u8s2wcs(*u8s);
     if (!wcs) return Nan::ThrowError(NewOleException(GetLastError()));
   }
+  Client *cl = Client::Unwrap<Client>(info.This());
+  CHECK_V8(Client, cl);
+  int nameCache = module_options.nameCache;
+  int apartmentKind = cl->apartmentKind;
+  if (info.Length() >= 2 && info[1]->IsObject())
+  {
+    Local<Value> vNameCache;
+    if (GET_PROP(Local<Object>::Cast(info[1]), "nameCache").ToLocal(&vNameCache) && !vNameCache->IsUndefined()
+      && !ParseNameCacheMode(vNameCache, &nameCache))
+    {
+      free(wcs);
+      return Nan::ThrowTypeError("nameCache must be 'none', 'object' or 'shared'");
+    }
+    Local<Value> vApartment;
+    if (GET_PROP(Local<Object>::Cast(info[1]), "apartment").ToLocal(&vApartment) && !vApartment->IsUndefined()
+      && !ParseApartmentKind(vApartment, &apartmentKind))
+    {
+      free(wcs);
+      return Nan::ThrowTypeError("apartment must be 'main', 'pool' or 'mta'");
+    }
+  }
 #ifdef DEBUG
   char *mbs = wcs2mbs(wcs);
   if (!mbs)
@@ -91,28 +191,24 @@ NAN_METHOD(Client::Dispatch)
   V8Dispatch *v8d = V8Dispatch::Unwrap<V8Dispatch>(vApp);
   CHECK_V8(V8Dispatch, v8d);
   OCDispatch *app = &v8d->ocd;
-  // When 'CoInitialize(NULL)' is not called first (and on the same instance),
-  // next functions will return many errors.
-  // (old style) GetActiveObject() returns 0x000036b7
-  //   The requested lookup key was not found in any active activation context.
-  // (OLE2) CoCreateInstance() returns 0x000003f0
-  //   An attempt was made to reference a token that does not exist.
-  // C -> C++ changes types (&clsid -> clsid, &IID_IDispatch -> IID_IDispatch)
-  // options (CLSCTX_INPROC_SERVER CLSCTX_INPROC_HANDLER CLSCTX_LOCAL_SERVER)
-  DWORD ctx = CLSCTX_INPROC_SERVER|CLSCTX_LOCAL_SERVER;
-  hr = CoCreateInstance(clsid, NULL, ctx, IID_IDispatch, (void **)&app->disp);
-  if(FAILED(hr)){
-    // Retry with WOW6432 bridge option.
-    // This may not be a right way, but better.
-    BDISPFUNCDAT("FAILED CoCreateInstance: %d: 0x%08x\n", 0, hr);
-#if defined(_WIN64)
-    ctx |= CLSCTX_ACTIVATE_32_BIT_SERVER; // 32bit COM server on 64bit OS
-#else
-    ctx |= CLSCTX_ACTIVATE_64_BIT_SERVER; // 64bit COM server on 32bit OS
-#endif
-    hr = CoCreateInstance(clsid, NULL, ctx, IID_IDispatch, (void **)&app->disp);
+  if (apartmentKind != ak_Main)
+  {
+    // the object lives on a thread of the pool (or in the MTA), node calls it through a proxy from now on
+    OCApartment* apartment;
+    hr = PoolApartment(apartmentKind == ak_Mta ? COINIT_MULTITHREADED : COINIT_APARTMENTTHREADED, &apartment);
+    if (FAILED(hr)) return Nan::ThrowError(NewOleException(hr));
+    CreateTask task(clsid);
+    hr = apartment->send(&task);
+    if (SUCCEEDED(hr)) hr = task.hr;
+    if (SUCCEEDED(hr)) hr = task.ref->get(IID_IDispatch, (void **)&app->disp);
+    if (SUCCEEDED(hr)) v8d->setApartment(apartment, task.ref);
+    if (task.ref) task.ref->Release();
+    if (FAILED(hr)) return Nan::ThrowError(NewOleException(hr));
+  } else {
+    hr = CreateDispatch(clsid, &app->disp);
     if (FAILED(hr)) return Nan::ThrowError(NewOleException(hr));
   }
+  v8d->setNameCacheMode(nameCache, &clsid);
   DISPFUNCOUT();
   return info.GetReturnValue().Set(vApp);
 }
@@ -133,6 +229,9 @@ void Client::Finalize()
 {
   if (!finalized)
   {
+    OCTypeCache::clear(); // lazily bound tables hold type information that must go before COM does
+    OCNameCache::clearShared();
+    V8Dispatch::ClearTypeCaches(); // and a new Client builds its classes from fresh tables
     oc.disconnect();
     finalized = true;
   }
@@ -15,12 +15,13 @@ public:
   static NAN_METHOD(Dispatch);
   static NAN_METHOD(Finalize);
 public:
-  Client() : finalized(false) {}
+  Client() : finalized(false), apartmentKind(0) {}
   ~Client() { if(!finalized) Finalize(); }
 protected:
   void Finalize();
 protected:
   bool finalized;
+  int apartmentKind; // where Dispatch puts objects unless told otherwise
   ole32core::OLE32core oc;
 };
 
@@ -13,6 +13,8 @@
 #include "v8dispmember.h"
 #include "v8dispmethod.h"
 #include "v8dispidxprop.h"
+#include "v8dispasync.h"
+#include "v8disppath.h"
 
 using namespace v8;
 using namespace ole32core;
@@ -84,6 +86,8 @@ NAN_MODULE_INIT(init)
   V8DispMember::Init(target);
   V8DispMethod::Init(target);
   V8DispIdxProperty::Init(target);
+  V8DispAsync::Init(target);
+  V8DispPath::Init(target);
   Client::Init(target);
   Nan::ForceSet(target, Nan::New("VERSION").ToLocalChecked(),
     Nan::New("0.0.0 (will be set later)").ToLocalChecked(),
@@ -101,6 +105,12 @@ NAN_MODULE_INIT(init)
   Nan::Export(target, "sleep", Method_sleep);
   Nan::Export(target, "force_gc_extension", Method_force_gc_extension);
   Nan::Export(target, "force_gc_internal", Method_force_gc_internal);
+  Nan::Export(target, "stats", Method_stats);
+  Nan::Export(target, "option", Method_option);
+  Nan::Export(target, "invoke", Method_invoke);
+  Nan::Export(target, "batch", Method_batch);
+  Nan::Export(target, "compile", Method_compile);
+  Nan::Export(target, "typeLibrary", Method_typeLibrary);
 }
 
 } // namespace
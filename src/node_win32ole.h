@@ -57,10 +57,31 @@ namespace node_win32ole {
 
 extern Nan::Persistent<Object> module_target;
 
+// tunables set through win32ole.option(name, value)
+struct Win32OLEOptions
+{
+  int nameCache; // ole32core::ENameCacheMode for objects without type information
+  bool lazyBinding; // resolve members through ITypeComp::Bind as they are used instead of reading whole types
+  bool typedTemplates; // give objects with type information a class of their own with real accessors
+  bool vtableCalls; // call members of in-process dual interfaces through their vtable instead of IDispatch::Invoke
+  unsigned stringCache; // how many short string arguments are kept as BSTRs, 0 to allocate one per call
+  unsigned apartmentThreads; // STA threads objects created with {apartment: 'pool'} are spread over, 0 for one per processor
+  bool typedArrays; // return one-dimensional numeric SAFEARRAYs as TypedArrays (Buffers for bytes) instead of Arrays
+  bool stringDedup; // share one V8 string between equal short strings of an array read from OLE
+};
+extern Win32OLEOptions module_options;
+extern bool ParseNameCacheMode(Local<Value> value, int* mode); // 'none', 'object' or 'shared'
+
 NAN_METHOD(Method_gettimeofday);
 NAN_METHOD(Method_sleep); // ms, bool: msg, bool: \n
 NAN_METHOD(Method_force_gc_extension); // v8/gc : gc()
 NAN_METHOD(Method_force_gc_internal);
+NAN_METHOD(Method_stats); // internal cache counters
+NAN_METHOD(Method_option); // name, [value]
+NAN_METHOD(Method_invoke); // dispatch, DISPID, flags, [VARTYPE...], args... (used by generated bindings)
+NAN_METHOD(Method_batch); // dispatch, [[name | DISPID, flags, [args]]...]
+NAN_METHOD(Method_compile); // dispatch, member path
+NAN_METHOD(Method_typeLibrary); // path or dispatch object
 
 } // namespace node_win32ole
 
@@ -323,34 +323,28 @@ ITypeInfo* OCDispatch::getTypeInfo()
 }
 
 // AutoWrap() - Automation helper function...
-HRESULT OCDispatch::invoke(WORD targetType, DISPID propID, VARIANT *pvResult, ErrorInfo& errorInfo, unsigned argLen, OCVariant **argchain)
+HRESULT OCDispatch::invoke(WORD targetType, DISPID propID, VARIANT *pvResult, ErrorInfo& errorInfo, unsigned argLen, VARIANT *args)
 {
-  // bug ? comment (see old ole32core.cpp project)
-  // unexpected free original BSTR
   if (!disp) {
     return E_POINTER;
   }
-  // bug ? comment (see old ole32core.cpp project)
-  // execute at the first time to safety free argchain
-  // Allocate memory for arguments...
-  unsigned int size = argchain ? argLen : 0;
-  VARIANT *pArgs = size ? (VARIANT*)alloca(size * sizeof(VARIANT)) : NULL;
-  for (unsigned int i = 0; i < size;  ++i) {
-    // bug ? comment (see old ole32core.cpp project)
-    // will be reallocated BSTR whein using VariantCopy() (see by debugger)
-    OCVariant *p = argchain[size - i - 1]; // arguments are passed in reverse order
-    VariantInit(&pArgs[i]); // It will be free before copy.
-    VariantCopy(&pArgs[i], &p->v);
-    delete p;
+  if (!info) getTypeInfo();
+  return invokeOn(disp, info, targetType, propID, pvResult, errorInfo, argLen, args);
+}
+
+HRESULT OCDispatch::invokeOn(IDispatch* disp, ITypeInfo* info, WORD targetType, DISPID propID, VARIANT *pvResult, ErrorInfo& errorInfo, unsigned argLen, VARIANT *args)
+{
+  if (!disp) {
+    return E_POINTER;
   }
   // Build DISPPARAMS
   DISPPARAMS dp = { NULL, NULL, 0, 0 };
-  dp.cArgs = size;
-  dp.rgvarg = pArgs;
+  dp.cArgs = args ? argLen : 0;
+  dp.rgvarg = args;
   // Handle special-case for property-puts!
   DISPID dispidNamed = DISPID_PROPERTYPUT;
-  if((targetType & DISPATCH_PROPERTYPUT) && size){
-    if (pArgs[0].vt == VT_DISPATCH)
+  if((targetType & DISPATCH_PROPERTYPUT) && dp.cArgs){
+    if (args[0].vt == VT_DISPATCH)
     { // PUTting DISPATCH values in must be done via "PROPERTYPUTREF", replace the bit being used
       targetType = ((targetType & ~DISPATCH_PROPERTYPUT) | DISPATCH_PROPERTYPUTREF);
     }
@@ -361,16 +355,12 @@ HRESULT OCDispatch::invoke(WORD targetType, DISPID propID, VARIANT *pvResult, Er
   memset(&exceptInfo, sizeof(exceptInfo), 0);
   // Make the call!
   HRESULT hr;
-  if (!info) getTypeInfo();
   if (info)
   {
     hr = DispInvoke(disp, info, propID, targetType, &dp, pvResult, &exceptInfo, NULL); // or _SYSTEM_ ?
   } else {
     hr = disp->Invoke(propID, IID_NULL, LOCALE_USER_DEFAULT, targetType, &dp, pvResult, &exceptInfo, NULL); // or _SYSTEM_ ?
   }
-  for (unsigned int i = 0; i < size; ++i) {
-    VariantClear(&pArgs[i]);
-  }
   if (hr == DISP_E_EXCEPTION)
   {
     // cleanup the error message a bit
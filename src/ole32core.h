@@ -4,6 +4,7 @@
 #include <ole2.h>
 #include <locale.h>
 
+#include <map>
 #include <vector>
 #include <iomanip>
 #include <iostream>
@@ -55,6 +56,104 @@ extern BSTR MBCS2BSTR(const std::string& str);
 // (not free bstr)
 extern std::string BSTR2MBCS(BSTR bstr);
 
+class OCCriticalSection {
+public:
+  OCCriticalSection() { InitializeCriticalSection(&cs); }
+  ~OCCriticalSection() { DeleteCriticalSection(&cs); }
+  void lock() { EnterCriticalSection(&cs); }
+  void unlock() { LeaveCriticalSection(&cs); }
+protected:
+  CRITICAL_SECTION cs;
+private:
+  OCCriticalSection(const OCCriticalSection&); // not copyable
+  OCCriticalSection& operator=(const OCCriticalSection&);
+};
+
+class OCAutoLock {
+public:
+  explicit OCAutoLock(OCCriticalSection& c) : cs(c) { cs.lock(); }
+  ~OCAutoLock() { cs.unlock(); }
+protected:
+  OCCriticalSection& cs;
+private:
+  OCAutoLock(const OCAutoLock&); // not copyable
+  OCAutoLock& operator=(const OCAutoLock&);
+};
+
+// Reference count of objects shared between threads and caches, deleted with the last Release
+class OCRefCounted {
+public:
+  ULONG AddRef() { return InterlockedIncrement(&refs); }
+  ULONG Release()
+  {
+    ULONG result = InterlockedDecrement(&refs);
+    if (!result) delete this;
+    return result;
+  }
+protected:
+  OCRefCounted() : refs(1) {}
+  virtual ~OCRefCounted() {}
+private:
+  LONG refs;
+  OCRefCounted(const OCRefCounted&); // not copyable
+  OCRefCounted& operator=(const OCRefCounted&);
+};
+
+// Process-wide map of OCRefCounted objects, a NULL entry remembers a key known to have none.
+// Entries are made outside the lock (that may call out of process), the first one inserted wins.
+template <class Key, class T, class Less = std::less<Key> >
+class OCSharedCache {
+public:
+  typedef std::map<Key, T*, Less> TEntryMap;
+  // true with an AddRef'ed *ppValue (NULL for a remembered miss) if key is cached
+  bool find(const Key& key, T** ppValue)
+  {
+    OCAutoLock lock(cs);
+    typename TEntryMap::const_iterator found = entries.find(key);
+    if (found == entries.end()) return false;
+    *ppValue = found->second;
+    if (*ppValue) (*ppValue)->AddRef();
+    return true;
+  }
+  // takes over the reference on value, returns the cached entry AddRef'ed
+  T* insert(const Key& key, T* value)
+  {
+    OCAutoLock lock(cs);
+    std::pair<typename TEntryMap::iterator, bool> inserted = entries.insert(typename TEntryMap::value_type(key, value));
+    if (!inserted.second)
+    {
+      // somebody else got here first, use theirs
+      if (value) value->Release();
+      value = inserted.first->second;
+    }
+    if (value) value->AddRef(); // one reference is kept by the cache
+    return value;
+  }
+  // empties the cache into taken, whose references now belong to the caller
+  void take(TEntryMap& taken)
+  {
+    OCAutoLock lock(cs);
+    taken.swap(entries);
+  }
+  void clear()
+  {
+    TEntryMap taken;
+    take(taken);
+    for (typename TEntryMap::iterator it = taken.begin(); it != taken.end(); ++it)
+    {
+      if (it->second) it->second->Release();
+    }
+  }
+  size_t size()
+  {
+    OCAutoLock lock(cs);
+    return entries.size();
+  }
+protected:
+  OCCriticalSection cs;
+  TEntryMap entries;
+};
+
 struct ErrorInfo {
   WORD  wCode;
   std::wstring sSource;
@@ -96,7 +195,10 @@ public:
 protected:
   ITypeInfo* info;
 public:
-  HRESULT invoke(WORD targetType, DISPID propID, VARIANT *pvResult, ErrorInfo& errorInfo, unsigned argLen, OCVariant **argchain);
+  // args are already in DISPPARAMS (reverse) order and stay owned by the caller
+  HRESULT invoke(WORD targetType, DISPID propID, VARIANT *pvResult, ErrorInfo& errorInfo, unsigned argLen, VARIANT *args);
+  // the same for any IDispatch, through DispInvoke when info is given
+  static HRESULT invokeOn(IDispatch* d, ITypeInfo* ti, WORD targetType, DISPID propID, VARIANT *pvResult, ErrorInfo& errorInfo, unsigned argLen, VARIANT *args);
 };
 
 class OLE32core {
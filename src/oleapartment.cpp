@@ -0,0 +1,278 @@
+/*
+  oleapartment.cpp
+  This source is independent of node/v8.
+*/
+
+#include "oleapartment.h"
+
+using namespace std;
+
+namespace ole32core {
+
+namespace {
+
+OCCriticalSection gitLock;
+IGlobalInterfaceTable* git = NULL; // the table is agile, one pointer serves every thread
+
+HRESULT globalInterfaceTable(IGlobalInterfaceTable** ppGit)
+{
+  OCAutoLock lock(gitLock);
+  if (!git)
+  {
+    HRESULT hr = CoCreateInstance(CLSID_StdGlobalInterfaceTable, NULL, CLSCTX_INPROC_SERVER,
+      IID_IGlobalInterfaceTable, (void**)&git);
+    if (FAILED(hr))
+    {
+      git = NULL;
+      return hr;
+    }
+  }
+  *ppGit = git;
+  return S_OK;
+}
+
+// carries a task sent to another thread, the sender waits for the event
+class OCSentTask : public OCTask {
+public:
+  OCSentTask(OCTask* t, HANDLE h) : task(t), hDone(h) {}
+  virtual void run() { task->run(); }
+  virtual void complete() { SetEvent(hDone); } // the sender may return and take us with it from here
+protected:
+  OCTask* task;
+  HANDLE hDone;
+};
+
+} // namespace
+
+OCApartment::OCApartment(DWORD coinit) : hThread(NULL), hReady(NULL), hWake(NULL), bStopping(false),
+  dwThreadId(0), dwCoinit(coinit), hrInit(S_OK), pending(0), residents(0)
+{
+}
+
+OCApartment::~OCApartment()
+{
+  stop();
+  if (hWake) CloseHandle(hWake);
+}
+
+HRESULT OCApartment::start()
+{
+  if (hThread) return S_FALSE;
+  if (!hWake) hWake = CreateEvent(NULL, FALSE, FALSE, NULL);
+  if (!hWake) return HRESULT_FROM_WIN32(GetLastError());
+  bStopping = false;
+  hReady = CreateEvent(NULL, TRUE, FALSE, NULL);
+  if (!hReady) return HRESULT_FROM_WIN32(GetLastError());
+  hThread = CreateThread(NULL, 0, threadProc, this, 0, &dwThreadId);
+  if (!hThread)
+  {
+    HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+    CloseHandle(hReady);
+    hReady = NULL;
+    return hr;
+  }
+  // the thread has its message queue (and apartment) once it's ready
+  WaitForSingleObject(hReady, INFINITE);
+  CloseHandle(hReady);
+  hReady = NULL;
+  if (FAILED(hrInit))
+  {
+    WaitForSingleObject(hThread, INFINITE);
+    CloseHandle(hThread);
+    hThread = NULL;
+    dwThreadId = 0;
+  }
+  return hrInit;
+}
+
+void OCApartment::stop()
+{
+  if (!hThread) return;
+  {
+    OCAutoLock lock(queueLock);
+    bStopping = true;
+  }
+  SetEvent(hWake);
+  WaitForSingleObject(hThread, INFINITE);
+  CloseHandle(hThread);
+  hThread = NULL;
+  dwThreadId = 0;
+}
+
+bool OCApartment::post(OCTask* task)
+{
+  if (!hThread) return false;
+  {
+    OCAutoLock lock(queueLock);
+    if (bStopping) return false;
+    tasks.push_back(task);
+    InterlockedIncrement(&pending);
+  }
+  SetEvent(hWake);
+  return true;
+}
+
+OCTask* OCApartment::next(bool& bStop)
+{
+  OCAutoLock lock(queueLock);
+  bStop = bStopping;
+  if (tasks.empty()) return NULL;
+  OCTask* task = tasks.front();
+  tasks.pop_front();
+  return task;
+}
+
+HRESULT OCApartment::send(OCTask* task)
+{
+  if (GetCurrentThreadId() == dwThreadId)
+  {
+    task->run();
+    return S_OK;
+  }
+  HANDLE hDone = CreateEvent(NULL, TRUE, FALSE, NULL);
+  if (!hDone) return HRESULT_FROM_WIN32(GetLastError());
+  OCSentTask sent(task, hDone);
+  HRESULT hr = post(&sent) ? S_OK : RPC_E_DISCONNECTED;
+  // the task may need the sender's apartment, like CoCreateInstance of a class without ThreadingModel
+  // (made in the main STA) or with ThreadingModel Apartment talking back: an STA sender keeps
+  // serving COM calls while it waits
+  if (SUCCEEDED(hr))
+  {
+    DWORD index;
+    hr = CoWaitForMultipleHandles(0, INFINITE, 1, &hDone, &index);
+    if (FAILED(hr)) WaitForSingleObject(hDone, INFINITE); // the task still uses sent, which lives on this stack
+    hr = S_OK;
+  }
+  CloseHandle(hDone);
+  return hr;
+}
+
+DWORD WINAPI OCApartment::threadProc(LPVOID param)
+{
+  OCApartment* self = (OCApartment*)param;
+  MSG msg;
+  PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE); // creates the message queue
+  HRESULT hr = CoInitializeEx(NULL, self->dwCoinit);
+  self->hrInit = hr;
+  SetEvent(self->hReady);
+  if (FAILED(hr)) return 1;
+
+  for (;;)
+  {
+    // objects of this apartment get their calls from other apartments (and their timers) as messages
+    while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+    {
+      TranslateMessage(&msg);
+      DispatchMessage(&msg);
+    }
+    bool bStop;
+    OCTask* task = self->next(bStop);
+    if (task)
+    {
+      task->run();
+      InterlockedDecrement(&self->pending);
+      task->complete();
+      continue;
+    }
+    if (bStop) break; // only once every task posted has run
+    if (MsgWaitForMultipleObjectsEx(1, &self->hWake, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE) == WAIT_FAILED) break;
+  }
+  CoUninitialize();
+  return 0;
+}
+
+OCApartmentPool::~OCApartmentPool()
+{
+  for (vector<OCApartment*>::iterator it = apartments.begin(); it != apartments.end(); ++it)
+  {
+    delete *it;
+  }
+}
+
+HRESULT OCApartmentPool::start(unsigned count)
+{
+  if (!apartments.empty()) return S_FALSE;
+  if (!count)
+  {
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    count = si.dwNumberOfProcessors ? si.dwNumberOfProcessors : 1;
+  }
+  for (unsigned i = 0; i < count; ++i)
+  {
+    OCApartment* apartment = new OCApartment(dwCoinit);
+    HRESULT hr = apartment->start();
+    if (FAILED(hr))
+    {
+      delete apartment;
+      if (apartments.empty()) return hr;
+      break; // make do with the threads we got
+    }
+    apartments.push_back(apartment);
+  }
+  return S_OK;
+}
+
+void OCApartmentPool::stop()
+{
+  // the apartments themselves stay, objects placed there may still be let go of
+  for (vector<OCApartment*>::iterator it = apartments.begin(); it != apartments.end(); ++it)
+  {
+    (*it)->stop();
+  }
+}
+
+OCApartment* OCApartmentPool::pick()
+{
+  OCApartment* result = NULL;
+  for (vector<OCApartment*>::iterator it = apartments.begin(); it != apartments.end(); ++it)
+  {
+    if (!result || (*it)->population() < result->population()
+      || ((*it)->population() == result->population() && (*it)->load() < result->load()))
+    {
+      result = *it;
+    }
+  }
+  return result;
+}
+
+OCApartment* OCApartmentPool::idlest()
+{
+  OCApartment* result = NULL;
+  for (vector<OCApartment*>::iterator it = apartments.begin(); it != apartments.end(); ++it)
+  {
+    if (!result || (*it)->load() < result->load()) result = *it;
+  }
+  return result;
+}
+
+HRESULT OCGlobalRef::create(IUnknown* punk, REFIID riid, OCGlobalRef** ppRef)
+{
+  if (!ppRef) return E_POINTER;
+  *ppRef = NULL;
+  if (!punk) return E_INVALIDARG;
+  IGlobalInterfaceTable* table;
+  HRESULT hr = globalInterfaceTable(&table);
+  if (FAILED(hr)) return hr;
+  DWORD cookie;
+  hr = table->RegisterInterfaceInGlobal(punk, riid, &cookie);
+  if (FAILED(hr)) return hr;
+  *ppRef = new OCGlobalRef(cookie);
+  return S_OK;
+}
+
+OCGlobalRef::~OCGlobalRef()
+{
+  IGlobalInterfaceTable* table;
+  if (SUCCEEDED(globalInterfaceTable(&table))) table->RevokeInterfaceFromGlobal(cookie);
+}
+
+HRESULT OCGlobalRef::get(REFIID riid, void** ppv)
+{
+  IGlobalInterfaceTable* table;
+  HRESULT hr = globalInterfaceTable(&table);
+  if (FAILED(hr)) return hr;
+  return table->GetInterfaceFromGlobal(cookie, riid, ppv);
+}
+
+} // namespace ole32core
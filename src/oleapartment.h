@@ -0,0 +1,91 @@
+#ifndef __OLEAPARTMENT_H__
+#define __OLEAPARTMENT_H__
+
+#include <deque>
+#include <vector>
+#include "ole32core.h"
+
+namespace ole32core {
+
+// work handed to an apartment thread
+class OCTask {
+public:
+  virtual ~OCTask() {}
+  virtual void run() = 0; // on the apartment thread
+  virtual void complete() = 0; // on the apartment thread right after run, the task belongs to whoever waits for it from now on
+};
+
+// A thread of its own, initialized as STA (with a message loop, so the objects living there are
+// serviced) or as a member of the process MTA. Tasks run one after the other in the order posted.
+// They are queued apart from the thread's messages: a modal loop running there (a server showing a
+// dialog, or waiting on a call out of the apartment) would take a posted message and drop it.
+class OCApartment {
+public:
+  explicit OCApartment(DWORD coinit); // COINIT_APARTMENTTHREADED or COINIT_MULTITHREADED
+  ~OCApartment(); // stops the thread
+  HRESULT start();
+  void stop(); // the tasks already posted still run
+  bool post(OCTask* task);
+  HRESULT send(OCTask* task); // runs task there and waits for it (an STA caller keeps serving COM calls), complete isn't called and the task stays the caller's
+  LONG load() const { return pending; } // tasks posted and not completed yet
+  void enter() { InterlockedIncrement(&residents); } // an object has been placed here
+  void leave() { InterlockedDecrement(&residents); }
+  LONG population() const { return residents; }
+  DWORD threadId() const { return dwThreadId; }
+  DWORD coinit() const { return dwCoinit; }
+protected:
+  static DWORD WINAPI threadProc(LPVOID param);
+  OCTask* next(bool& bStop); // the oldest task queued, or NULL with bStop telling whether the thread should end
+  HANDLE hThread;
+  HANDLE hReady;
+  HANDLE hWake; // set when a task is queued or the thread is asked to stop
+  OCCriticalSection queueLock;
+  std::deque<OCTask*> tasks;
+  bool bStopping;
+  DWORD dwThreadId;
+  DWORD dwCoinit;
+  HRESULT hrInit;
+  volatile LONG pending;
+  volatile LONG residents;
+private:
+  OCApartment(const OCApartment&); // not copyable
+  OCApartment& operator=(const OCApartment&);
+};
+
+// A fixed number of apartments of one kind, new objects go to the one with the fewest residents.
+// Threads of a COINIT_MULTITHREADED pool all share the MTA, so any of them can call the objects of the others.
+class OCApartmentPool {
+public:
+  explicit OCApartmentPool(DWORD coinit) : dwCoinit(coinit) {}
+  ~OCApartmentPool();
+  HRESULT start(unsigned count); // 0 is one per processor
+  void stop(); // for good, posting to the apartments fails from now on
+  OCApartment* pick(); // NULL until started
+  OCApartment* idlest(); // the one with the fewest tasks waiting, NULL until started
+  unsigned size() const { return (unsigned)apartments.size(); }
+protected:
+  DWORD dwCoinit;
+  std::vector<OCApartment*> apartments;
+private:
+  OCApartmentPool(const OCApartmentPool&); // not copyable
+  OCApartmentPool& operator=(const OCApartmentPool&);
+};
+
+// An interface registered in the global interface table, so any apartment can get its own
+// (proxy or direct) pointer to it. Reference counted, revoked with the last reference from any thread.
+class OCGlobalRef : public OCRefCounted {
+public:
+  static HRESULT create(IUnknown* punk, REFIID riid, OCGlobalRef** ppRef); // punk belongs to the calling apartment
+  HRESULT get(REFIID riid, void** ppv); // AddRef'ed for the calling apartment
+protected:
+  OCGlobalRef(DWORD c) : cookie(c) {}
+  ~OCGlobalRef();
+  DWORD cookie;
+private:
+  OCGlobalRef(const OCGlobalRef&); // not copyable
+  OCGlobalRef& operator=(const OCGlobalRef&);
+};
+
+} // namespace ole32core
+
+#endif // __OLEAPARTMENT_H__
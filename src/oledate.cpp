@@ -0,0 +1,104 @@
+/*
+  oledate.cpp
+  This source is independent of node/v8.
+*/
+
+#include "oledate.h"
+#include <ctime>
+
+namespace ole32core {
+
+namespace {
+
+const double PROBE_STEP = 7 * 86400.0; // seconds, no zone changes its offset twice within a week
+const double PERIOD_LIMIT = 366 * 86400.0; // a period without a change is cut there all the same
+
+// the first second (going in direction dir from the whole second from) whose offset differs,
+// or where the search gives up
+double Edge(OCLocalTime::OffsetFn offsetAt, double from, long offset, double dir)
+{
+  double inside = from;
+  while (std::fabs(inside - from) < PERIOD_LIMIT)
+  {
+    double probe = inside + dir * PROBE_STEP;
+    if (offsetAt(probe) != offset)
+    {
+      // the change is somewhere in this week, narrow it down to the second
+      while (std::fabs(probe - inside) > 1)
+      {
+        double mid = std::floor((inside + probe) / 2);
+        if (offsetAt(mid) == offset) inside = mid;
+        else probe = mid;
+      }
+      return probe;
+    }
+    inside = probe;
+  }
+  return from + dir * PERIOD_LIMIT;
+}
+
+} // namespace
+
+void OleDatesToMs(const double* dates, double* ms, size_t count)
+{
+  for (size_t i = 0; i < count; ++i) ms[i] = OleDateToMs(dates[i]);
+}
+
+long OCLocalTime::SystemOffset(double utcSec)
+{
+  // the C library only knows its own range of time_t (none before 1970 on Windows), outside it
+  // the offset at the nearest end is used
+#ifdef _WIN32
+  if (utcSec < 0) utcSec = 0;
+  if (utcSec > 32535215999.0) utcSec = 32535215999.0; // 3000-12-31
+  time_t t = (time_t)utcSec;
+  struct tm local;
+  if (localtime_s(&local, &t)) return 0;
+  return (long)(_mkgmtime(&local) - t);
+#else
+  time_t t = (time_t)std::floor(utcSec);
+  struct tm local;
+  if (!localtime_r(&t, &local)) return 0;
+  return (long)local.tm_gmtoff;
+#endif
+}
+
+double OCLocalTime::offsetMs(double utcMs)
+{
+  if (utcMs != utcMs) return 0; // NaN, an invalid Date
+  return lookup(utcMs).offset;
+}
+
+const OCLocalTime::Period& OCLocalTime::lookup(double utcMs)
+{
+  if (last < table.size() && table[last].start <= utcMs && utcMs < table[last].end) return table[last];
+  // the first period starting after utcMs, the one before it may hold it
+  size_t lo = 0, hi = table.size();
+  while (lo < hi)
+  {
+    size_t mid = (lo + hi) / 2;
+    if (table[mid].start <= utcMs) lo = mid + 1;
+    else hi = mid;
+  }
+  if (lo && utcMs < table[lo - 1].end) return table[last = lo - 1];
+  Period p = find(utcMs);
+  // periods cut short by PERIOD_LIMIT may meet the new one, they must not overlap
+  if (lo && p.start < table[lo - 1].end) p.start = table[lo - 1].end;
+  if (lo < table.size() && p.end > table[lo].start) p.end = table[lo].start;
+  table.insert(table.begin() + lo, p);
+  return table[last = lo];
+}
+
+OCLocalTime::Period OCLocalTime::find(double utcMs)
+{
+  double sec = std::floor(utcMs / 1000);
+  long offset = offsetAt(sec);
+  Period p;
+  p.offset = offset * 1000.0;
+  p.end = Edge(offsetAt, sec, offset, 1) * 1000;
+  // Edge returns the last second of the period before, which is not ours
+  p.start = (Edge(offsetAt, sec, offset, -1) + 1) * 1000;
+  return p;
+}
+
+} // namespace ole32core
@@ -0,0 +1,71 @@
+#ifndef __OLEDATE_H__
+#define __OLEDATE_H__
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace ole32core {
+
+// OLE automation dates count days from 1899-12-30, the fraction being the time of that day even
+// before it: -1.25 is 1899-12-29 06:00. They are converted arithmetically to and from milliseconds
+// since 1970-01-01 on the same (wall) clock, with no time zone involved.
+const double OLE_DATE_EPOCH = 25569.0; // 1970-01-01
+const double MS_PER_DAY = 86400000.0;
+const double OLE_DATE_MIN = -657434.0; // 0100-01-01
+const double OLE_DATE_MAX = 2958466.0; // 10000-01-01
+
+inline double OleDateToMs(double dt)
+{
+  double day = dt < 0 ? std::ceil(dt) : std::floor(dt);
+  double linear = day + std::fabs(dt - day);
+  return std::floor((linear - OLE_DATE_EPOCH) * MS_PER_DAY + 0.5); // to the nearest millisecond
+}
+
+inline double MsToOleDate(double ms)
+{
+  double linear = ms / MS_PER_DAY + OLE_DATE_EPOCH;
+  if (linear >= 0) return linear;
+  double day = std::floor(linear);
+  double time = linear - day;
+  return time ? day - time : day;
+}
+
+// the kernel for whole arrays of dates, wall clock milliseconds
+void OleDatesToMs(const double* dates, double* ms, size_t count);
+
+// Converts between UTC and the local wall clock with the offsets in effect at the time. An offset
+// is asked of the system once per period it holds for (between two DST changes), and kept in a
+// table the later conversions in that period read it from.
+class OCLocalTime {
+public:
+  // seconds east of UTC at a time given in seconds since 1970-01-01 UTC
+  typedef long (*OffsetFn)(double utcSec);
+  static long SystemOffset(double utcSec);
+  explicit OCLocalTime(OffsetFn offsetAt = SystemOffset) : offsetAt(offsetAt), last(0) {}
+  double toLocal(double utcMs) { return utcMs + offsetMs(utcMs); }
+  // wall clock times skipped by a change use the offset before it, repeated ones the one after
+  double toUtc(double localMs)
+  {
+    double guess = localMs - offsetMs(localMs);
+    return localMs - offsetMs(guess);
+  }
+  double offsetMs(double utcMs);
+  size_t periods() const { return table.size(); }
+protected:
+  struct Period
+  {
+    double start; // ms, inclusive
+    double end; // ms, exclusive
+    double offset; // ms
+  };
+  const Period& lookup(double utcMs);
+  Period find(double utcMs);
+  OffsetFn offsetAt;
+  std::vector<Period> table; // ordered, not overlapping
+  size_t last; // where the previous lookup hit, dates usually come in runs
+};
+
+} // namespace ole32core
+
+#endif // __OLEDATE_H__
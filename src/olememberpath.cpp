@@ -0,0 +1,321 @@
+/*
+  olememberpath.cpp
+  This source is independent of node/v8.
+*/
+
+#include "olememberpath.h"
+#include <wctype.h>
+
+using namespace std;
+
+namespace ole32core {
+
+namespace {
+
+void DispatchTypeOf(ITypeInfo* tinfo, ITypeInfo** ppDispatch);
+
+// the dispinterface a TYPEDESC names (through pointers and aliases), NULL for anything else
+void DispatchTypeOf(ITypeInfo* tinfo, const TYPEDESC& tdesc, ITypeInfo** ppDispatch)
+{
+  *ppDispatch = NULL;
+  const TYPEDESC* t = &tdesc;
+  while (t->vt == VT_PTR) t = t->lptdesc;
+  if (t->vt != VT_USERDEFINED) return;
+  ITypeInfo* ref;
+  if (FAILED(tinfo->GetRefTypeInfo(t->hreftype, &ref))) return;
+  DispatchTypeOf(ref, ppDispatch);
+  ref->Release();
+}
+
+// the dispinterface objects of this type are called through: itself, the dispatch half of a dual
+// interface or the default interface of a coclass; NULL if the type can't tell
+void DispatchTypeOf(ITypeInfo* tinfo, ITypeInfo** ppDispatch)
+{
+  *ppDispatch = NULL;
+  TYPEATTR* tattr;
+  if (FAILED(tinfo->GetTypeAttr(&tattr))) return;
+  switch (tattr->typekind)
+  {
+  case TKIND_DISPATCH:
+    tinfo->AddRef();
+    *ppDispatch = tinfo;
+    break;
+  case TKIND_INTERFACE:
+    if (tattr->wTypeFlags & TYPEFLAG_FDUAL)
+    {
+      HREFTYPE href;
+      if (FAILED(tinfo->GetRefTypeOfImplType((UINT)-1, &href)) || FAILED(tinfo->GetRefTypeInfo(href, ppDispatch)))
+      {
+        *ppDispatch = NULL;
+      }
+    }
+    break;
+  case TKIND_COCLASS:
+    for (UINT i = 0; i < tattr->cImplTypes; ++i)
+    {
+      INT implFlags;
+      if (FAILED(tinfo->GetImplTypeFlags(i, &implFlags))) continue;
+      if (!(implFlags & IMPLTYPEFLAG_FDEFAULT) || (implFlags & IMPLTYPEFLAG_FSOURCE)) continue;
+      HREFTYPE href;
+      ITypeInfo* iface;
+      if (SUCCEEDED(tinfo->GetRefTypeOfImplType(i, &href)) && SUCCEEDED(tinfo->GetRefTypeInfo(href, &iface)))
+      {
+        DispatchTypeOf(iface, ppDispatch);
+        iface->Release();
+      }
+      break;
+    }
+    break;
+  case TKIND_ALIAS:
+    DispatchTypeOf(tinfo, tattr->tdescAlias, ppDispatch);
+    break;
+  default:
+    break;
+  }
+  tinfo->ReleaseTypeAttr(tattr);
+}
+
+// how many arguments the member of a dispinterface takes when read or called (-1 if it can't tell),
+// and the dispinterface of what it returns
+void DescribeMember(ITypeInfo* tinfo, MEMBERID memid, int* pParams, ITypeInfo** ppResult)
+{
+  *pParams = -1;
+  *ppResult = NULL;
+  TYPEATTR* tattr;
+  if (FAILED(tinfo->GetTypeAttr(&tattr))) return;
+  bool found = false;
+  for (UINT i = 0; i < tattr->cFuncs && !found; ++i)
+  {
+    FUNCDESC* funcdesc;
+    if (FAILED(tinfo->GetFuncDesc(i, &funcdesc))) continue;
+    if (funcdesc->memid == memid && (funcdesc->invkind & (INVOKE_FUNC | INVOKE_PROPERTYGET)))
+    {
+      found = true;
+      int params = 0;
+      for (SHORT p = 0; p < funcdesc->cParams; ++p)
+      {
+        if (!(funcdesc->lprgelemdescParam[p].paramdesc.wParamFlags & (PARAMFLAG_FRETVAL | PARAMFLAG_FLCID))) ++params;
+      }
+      *pParams = params;
+      DispatchTypeOf(tinfo, funcdesc->elemdescFunc.tdesc, ppResult);
+    }
+    tinfo->ReleaseFuncDesc(funcdesc);
+  }
+  for (UINT i = 0; i < tattr->cVars && !found; ++i)
+  {
+    VARDESC* vardesc;
+    if (FAILED(tinfo->GetVarDesc(i, &vardesc))) continue;
+    if (vardesc->memid == memid)
+    {
+      found = true;
+      *pParams = 0;
+      DispatchTypeOf(tinfo, vardesc->elemdescVar.tdesc, ppResult);
+    }
+    tinfo->ReleaseVarDesc(vardesc);
+  }
+  tinfo->ReleaseTypeAttr(tattr);
+}
+
+inline const wchar_t* SkipSpaces(const wchar_t* p)
+{
+  while (iswspace(*p)) ++p;
+  return p;
+}
+
+} // namespace
+
+HRESULT OCMemberPath::compile(ITypeInfo* root, const wchar_t* path, OCMemberPath** ppPath)
+{
+  if (!ppPath) return E_POINTER;
+  *ppPath = NULL;
+  OCMemberPath* result = new OCMemberPath();
+  HRESULT hr = result->parse(path);
+  if (SUCCEEDED(hr)) hr = result->bind(root);
+  if (FAILED(hr))
+  {
+    result->Release();
+    return hr;
+  }
+  *ppPath = result;
+  return S_OK;
+}
+
+HRESULT OCMemberPath::parse(const wchar_t* path)
+{
+  // name [( ? [, ?]... )] [. name ...]
+  const wchar_t* p = path;
+  for (;;)
+  {
+    p = SkipSpaces(p);
+    const wchar_t* start = p;
+    while (iswalnum(*p) || *p == L'_') ++p;
+    if (p == start) return E_INVALIDARG;
+    Hop hop;
+    hop.name.assign(start, p - start);
+    hop.id = hop.name == L"_" ? DISPID_VALUE : DISPID_UNKNOWN;
+    hop.argc = 0;
+    p = SkipSpaces(p);
+    if (*p == L'(')
+    {
+      p = SkipSpaces(p + 1);
+      if (*p != L')')
+      {
+        for (;;)
+        {
+          if (*p != L'?') return E_INVALIDARG;
+          ++hop.argc;
+          p = SkipSpaces(p + 1);
+          if (*p == L')') break;
+          if (*p != L',') return E_INVALIDARG;
+          p = SkipSpaces(p + 1);
+        }
+      }
+      p = SkipSpaces(p + 1);
+    }
+    placeholders += hop.argc;
+    hops.push_back(hop);
+    if (!*p) return S_OK;
+    if (*p != L'.') return E_INVALIDARG;
+    ++p;
+  }
+}
+
+HRESULT OCMemberPath::bind(ITypeInfo* root)
+{
+  ITypeInfo* tinfo = NULL;
+  if (root) DispatchTypeOf(root, &tinfo);
+  TYPEATTR* tattr;
+  if (tinfo && SUCCEEDED(tinfo->GetTypeAttr(&tattr)))
+  {
+    rootType = tattr->guid;
+    tinfo->ReleaseTypeAttr(tattr);
+  }
+  // hops are bound as long as the type of their object is known
+  for (size_t i = 0; i < hops.size() && tinfo; ++i)
+  {
+    if (hops[i].id == DISPID_UNKNOWN)
+    {
+      LPOLESTR name = const_cast<LPOLESTR>(hops[i].name.c_str());
+      MEMBERID memid;
+      HRESULT hr = tinfo->GetIDsOfNames(&name, 1, &memid);
+      if (FAILED(hr))
+      {
+        tinfo->Release();
+        return hr;
+      }
+      hops[i].id = memid;
+    }
+    int params;
+    ITypeInfo* next;
+    DescribeMember(tinfo, hops[i].id, &params, &next);
+    tinfo->Release();
+    tinfo = next;
+    if (hops[i].argc && !params && tinfo)
+    {
+      // a property without parameters given some, like rs.Fields(name): they go to the default member of its value
+      Hop item;
+      item.id = DISPID_VALUE;
+      item.argc = hops[i].argc;
+      hops[i].argc = 0;
+      hops.insert(hops.begin() + ++i, item);
+      DescribeMember(tinfo, DISPID_VALUE, &params, &next);
+      tinfo->Release();
+      tinfo = next;
+    }
+  }
+  if (tinfo) tinfo->Release();
+  return S_OK;
+}
+
+bool OCMemberPath::bindsTo(ITypeInfo* tinfo)
+{
+  if (IsEqualGUID(rootType, GUID_NULL)) return true; // nothing was bound by type
+  if (!tinfo) return false;
+  if (tinfo == lastMatch) return true;
+  ITypeInfo* dispatch;
+  DispatchTypeOf(tinfo, &dispatch);
+  if (!dispatch) return false;
+  bool bMatch = false;
+  TYPEATTR* tattr;
+  if (SUCCEEDED(dispatch->GetTypeAttr(&tattr)))
+  {
+    bMatch = IsEqualGUID(tattr->guid, rootType) != FALSE;
+    dispatch->ReleaseTypeAttr(tattr);
+  }
+  dispatch->Release();
+  if (bMatch)
+  {
+    tinfo->AddRef();
+    if (lastMatch) lastMatch->Release();
+    lastMatch = tinfo;
+  }
+  return bMatch;
+}
+
+HRESULT OCMemberPath::run(IDispatch* disp, ITypeInfo* tinfo, VARIANT* args, bool bPut, VARIANT* pvResult, ErrorInfo& errInfo)
+{
+  VariantInit(pvResult);
+  if (!disp) return E_POINTER;
+  // the DISPIDs of another type would call unrelated members, such an object is walked by name
+  bool bByName = !bindsTo(tinfo);
+  disp->AddRef();
+  // last to first, the arguments of every hop are a block of their own, those of the first hop at the end
+  VARIANT* next = args + placeholders + (bPut ? 1 : 0);
+  HRESULT hr = S_OK;
+  for (size_t i = 0; i < hops.size(); ++i)
+  {
+    const Hop& hop = hops[i];
+    bool bAssign = bPut && i + 1 == hops.size();
+    DISPID id = hop.id;
+    if (bByName && !hop.name.empty() && hop.name != L"_") id = DISPID_UNKNOWN; // default members keep DISPID_VALUE
+    if (id == DISPID_UNKNOWN)
+    {
+      LPOLESTR name = const_cast<LPOLESTR>(hop.name.c_str());
+      hr = disp->GetIDsOfNames(IID_NULL, &name, 1, LOCALE_USER_DEFAULT, &id);
+      if (FAILED(hr)) break;
+    }
+    // with a put the block of the last hop starts with the value, as DISPPARAMS wants it
+    unsigned argc = hop.argc + (bAssign ? 1 : 0);
+    next -= argc;
+    // intermediate objects are called without their type information, only the DISPID is needed
+    VARIANT result;
+    VariantInit(&result);
+    hr = OCDispatch::invokeOn(disp, NULL, bAssign ? DISPATCH_PROPERTYPUT : DISPATCH_METHOD | DISPATCH_PROPERTYGET,
+      id, bAssign ? NULL : &result, errInfo, argc, next);
+    disp->Release();
+    disp = NULL;
+    if (FAILED(hr))
+    {
+      VariantClear(&result);
+      break;
+    }
+    if (i + 1 == hops.size())
+    {
+      *pvResult = result;
+      break;
+    }
+    // only an object can be walked on
+    if (result.vt == VT_UNKNOWN && result.punkVal)
+    {
+      result.punkVal->QueryInterface(IID_IDispatch, (void**)&disp);
+      VariantClear(&result);
+    }
+    else if (result.vt == VT_DISPATCH)
+    {
+      disp = result.pdispVal; // takes the reference
+    }
+    else
+    {
+      VariantClear(&result);
+    }
+    if (!disp)
+    {
+      hr = DISP_E_TYPEMISMATCH;
+      break;
+    }
+  }
+  if (disp) disp->Release();
+  return hr;
+}
+
+} // namespace ole32core
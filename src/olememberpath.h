@@ -0,0 +1,46 @@
+#ifndef __OLEMEMBERPATH_H__
+#define __OLEMEMBERPATH_H__
+
+#include <string>
+#include <vector>
+#include "ole32core.h"
+
+namespace ole32core {
+
+// A chain of member accesses like "Cells(?,?).Interior.ColorIndex", bound once against the type of
+// its first object: every hop whose object type the type library tells gets its DISPID up front,
+// the rest (members typed as plain IDispatch or VARIANT) are looked up with GetIDsOfNames when run.
+// Each ? stands for an argument given to run, in order. Objects of another type than the first one
+// are walked by name, through GetIDsOfNames at every hop.
+class OCMemberPath : public OCRefCounted {
+public:
+  static HRESULT compile(ITypeInfo* root, const wchar_t* path, OCMemberPath** ppPath);
+  unsigned argCount() const { return placeholders; }
+  // walks the chain from disp (whose type is tinfo, NULL if unknown), args holds argCount() values in
+  // DISPPARAMS order (last to first) and stays the caller's. With bPut the last member is assigned the
+  // value in args[0], which comes after every argument, instead of read, and pvResult is left empty
+  HRESULT run(IDispatch* disp, ITypeInfo* tinfo, VARIANT* args, bool bPut, VARIANT* pvResult, ErrorInfo& errInfo);
+protected:
+  struct Hop
+  {
+    std::wstring name;
+    DISPID id; // DISPID_UNKNOWN to ask the object
+    unsigned argc;
+  };
+  OCMemberPath() : rootType(GUID_NULL), lastMatch(NULL), placeholders(0) {}
+  ~OCMemberPath() { if (lastMatch) lastMatch->Release(); }
+  HRESULT parse(const wchar_t* path);
+  HRESULT bind(ITypeInfo* root);
+  bool bindsTo(ITypeInfo* tinfo); // whether the DISPIDs bound up front are those of objects of this type
+  std::vector<Hop> hops;
+  GUID rootType; // the dispinterface the hops were bound against, GUID_NULL if none
+  ITypeInfo* lastMatch; // the type last found to be it, objects of one type usually share its ITypeInfo
+  unsigned placeholders;
+private:
+  OCMemberPath(const OCMemberPath&); // not copyable
+  OCMemberPath& operator=(const OCMemberPath&);
+};
+
+} // namespace ole32core
+
+#endif // __OLEMEMBERPATH_H__
@@ -0,0 +1,420 @@
+/*
+  oletypeindex.cpp
+  This source is independent of node/v8.
+*/
+
+#include "oletypeindex.h"
+#include <algorithm>
+#include <cstddef>
+
+using namespace std;
+
+namespace ole32core {
+
+static const DWORD INDEX_MAGIC = 0x49323357; // "W32I"
+static const DWORD INDEX_VERSION = 2; // bump whenever the layout or the meaning of MemberInfo changes
+
+enum ETypeRecordFlags
+{
+  tf_HasDefaultProp = 1
+};
+
+// Everything up to typeCount is the stamp, an index is only used if it matches the library byte for byte.
+// The header is followed by typeCount TypeRecords (sorted by guid and kind), memberCount MemberRecords,
+// paramCount ParamRecords and nameChars characters of names, which are not NUL terminated.
+struct OCTypeIndex::Header
+{
+  DWORD magic;
+  DWORD version;
+  GUID libid;
+  DWORD libVersion; // MAKELONG(minor, major)
+  LCID lcid;
+  DWORD syskind;
+  FILETIME libTime; // of the type library file the index was built from
+  DWORD libSizeLow;
+  DWORD libSizeHigh;
+  DWORD typeCount;
+  DWORD memberCount;
+  DWORD paramCount;
+  DWORD nameChars;
+};
+
+struct OCTypeIndex::TypeRecord
+{
+  GUID guid;
+  DWORD kind; // TYPEKIND
+  DWORD flags; // ETypeRecordFlags
+  DWORD name; // offset into the names, in characters
+  DWORD nameLength;
+  DWORD firstMember;
+  DWORD memberCount;
+};
+
+struct OCTypeIndex::MemberRecord
+{
+  DISPID memberID;
+  DWORD attrs; // EMemberAttr
+  DWORD name;
+  DWORD nameLength;
+  WORD vt;
+  SHORT paramCount; // -1 if the signature is unknown
+  SHORT requiredCount;
+  WORD reserved;
+  DWORD firstParam;
+};
+
+struct ParamRecord
+{
+  WORD vt;
+  WORD flags; // EParamFlags
+};
+
+namespace {
+
+struct LibKey
+{
+  GUID libid;
+  DWORD libVersion;
+  LCID lcid;
+  DWORD syskind;
+  bool operator<(const LibKey& other) const
+  {
+    int cmp = memcmp(&libid, &other.libid, sizeof(GUID));
+    if (cmp) return cmp < 0;
+    if (libVersion != other.libVersion) return libVersion < other.libVersion;
+    if (lcid != other.lcid) return lcid < other.lcid;
+    return syskind < other.syskind;
+  }
+};
+
+OCCriticalSection indexLock; // of indexDirectory
+OCSharedCache<LibKey, OCTypeIndex> indexEntries;
+wstring indexDirectory;
+
+int compareType(const GUID& leftGuid, DWORD leftKind, const GUID& rightGuid, DWORD rightKind)
+{
+  int cmp = memcmp(&leftGuid, &rightGuid, sizeof(GUID));
+  if (cmp) return cmp;
+  return leftKind < rightKind ? -1 : leftKind > rightKind ? 1 : 0;
+}
+
+struct TypeRecordLess
+{
+  bool operator()(const OCTypeIndex::TypeRecord& left, const OCTypeIndex::TypeRecord& right) const
+  {
+    return compareType(left.guid, left.kind, right.guid, right.kind) < 0;
+  }
+};
+
+// the library attributes plus the time and size of the file it was loaded from
+HRESULT readStamp(ITypeLib* tlib, OCTypeIndex::Header& stamp)
+{
+  TLIBATTR* lattr;
+  HRESULT hr = tlib->GetLibAttr(&lattr);
+  if (FAILED(hr)) return hr;
+  memset(&stamp, 0, sizeof(stamp));
+  stamp.magic = INDEX_MAGIC;
+  stamp.version = INDEX_VERSION;
+  stamp.libid = lattr->guid;
+  stamp.libVersion = MAKELONG(lattr->wMinorVerNum, lattr->wMajorVerNum);
+  stamp.lcid = lattr->lcid;
+  stamp.syskind = lattr->syskind;
+  BSTR bPath;
+  hr = QueryPathOfRegTypeLib(lattr->guid, lattr->wMajorVerNum, lattr->wMinorVerNum, lattr->lcid, &bPath);
+  tlib->ReleaseTLibAttr(lattr);
+  if (FAILED(hr)) return S_FALSE; // not registered, we couldn't tell when it changes
+
+  wstring path(bPath, SysStringLen(bPath));
+  SysFreeString(bPath);
+  WIN32_FILE_ATTRIBUTE_DATA fad;
+  BOOL bFound = GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &fad);
+  if (!bFound)
+  {
+    // libraries embedded as a resource are registered as "excel.exe\3"
+    size_t sep = path.find_last_of(L'\\');
+    if (sep != wstring::npos && sep + 1 < path.length() && path.find_first_not_of(L"0123456789", sep + 1) == wstring::npos)
+    {
+      path.erase(sep);
+      bFound = GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &fad);
+    }
+  }
+  if (!bFound) return S_FALSE;
+  stamp.libTime = fad.ftLastWriteTime;
+  stamp.libSizeLow = fad.nFileSizeLow;
+  stamp.libSizeHigh = fad.nFileSizeHigh;
+  return S_OK;
+}
+
+wstring indexFileName(const OCTypeIndex::Header& stamp)
+{
+  wchar_t szGuid[40];
+  if (!StringFromGUID2(stamp.libid, szGuid, sizeof(szGuid) / sizeof(szGuid[0]))) szGuid[0] = L'\0';
+  wchar_t szName[128];
+  swprintf_s(szName, L"%s_%x.%x_%x_%u.idx", szGuid, HIWORD(stamp.libVersion), LOWORD(stamp.libVersion), stamp.lcid, stamp.syskind);
+  return szName;
+}
+
+} // namespace
+
+OCTypeIndex::OCTypeIndex() : mapping(NULL), view(NULL), viewSize(0)
+{
+}
+
+OCTypeIndex::~OCTypeIndex()
+{
+  unmap();
+}
+
+void OCTypeIndex::setDirectory(const wstring& dir)
+{
+  OCAutoLock lock(indexLock);
+  indexDirectory = dir;
+}
+
+wstring OCTypeIndex::getDirectory()
+{
+  OCAutoLock lock(indexLock);
+  return indexDirectory;
+}
+
+HRESULT OCTypeIndex::open(ITypeInfo* tinfo, OCTypeIndex** ppIndex)
+{
+  if (!ppIndex) return E_POINTER;
+  *ppIndex = NULL;
+  wstring dir = getDirectory();
+  if (dir.empty() || !tinfo) return S_FALSE;
+
+  ITypeLib* tlib;
+  UINT tindex;
+  if (FAILED(tinfo->GetContainingTypeLib(&tlib, &tindex))) return S_FALSE; // not from a library
+  Header stamp;
+  HRESULT hr = readStamp(tlib, stamp);
+  if (hr != S_OK)
+  {
+    tlib->Release();
+    return FAILED(hr) ? hr : S_FALSE;
+  }
+
+  LibKey key;
+  key.libid = stamp.libid;
+  key.libVersion = stamp.libVersion;
+  key.lcid = stamp.lcid;
+  key.syskind = stamp.syskind;
+  if (indexEntries.find(key, ppIndex))
+  {
+    tlib->Release();
+    return *ppIndex ? S_OK : S_FALSE;
+  }
+
+  // map (or build) outside the lock, building walks the whole library
+  OCTypeIndex* index = new OCTypeIndex();
+  if (dir[dir.length() - 1] != L'\\' && dir[dir.length() - 1] != L'/') dir += L'\\';
+  wstring path = dir + indexFileName(stamp);
+  if (!index->map(path, stamp))
+  {
+    // missing, damaged, or built from another copy of the library
+    CreateDirectoryW(dir.c_str(), NULL);
+    if (SUCCEEDED(build(tlib, path, stamp))) index->map(path, stamp);
+  }
+  tlib->Release();
+  if (!index->view)
+  {
+    // remember the failure as well, a library is only built once per process
+    index->Release();
+    index = NULL;
+  }
+
+  index = indexEntries.insert(key, index);
+  *ppIndex = index;
+  return index ? S_OK : S_FALSE;
+}
+
+bool OCTypeIndex::map(const wstring& path, const Header& stamp)
+{
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  DWORD sizeHigh = 0;
+  DWORD size = GetFileSize(file, &sizeHigh);
+  if (size != INVALID_FILE_SIZE && !sizeHigh && size >= sizeof(Header))
+  {
+    mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  }
+  CloseHandle(file); // the mapping keeps it open
+  if (!mapping) return false;
+  view = (const BYTE*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  viewSize = size;
+  if (!view)
+  {
+    unmap();
+    return false;
+  }
+
+  const Header* header = (const Header*)view;
+  ULONGLONG expected = sizeof(Header) + (ULONGLONG)header->typeCount * sizeof(TypeRecord)
+    + (ULONGLONG)header->memberCount * sizeof(MemberRecord) + (ULONGLONG)header->paramCount * sizeof(ParamRecord)
+    + (ULONGLONG)header->nameChars * sizeof(wchar_t);
+  if (memcmp(header, &stamp, offsetof(Header, typeCount)) || expected != viewSize)
+  {
+    unmap();
+    return false;
+  }
+  return true;
+}
+
+void OCTypeIndex::unmap()
+{
+  if (view)
+  {
+    UnmapViewOfFile(view);
+    view = NULL;
+  }
+  if (mapping)
+  {
+    CloseHandle(mapping);
+    mapping = NULL;
+  }
+  viewSize = 0;
+}
+
+HRESULT OCTypeIndex::load(REFGUID guid, TYPEKIND kind, OCTypeMembers& type) const
+{
+  if (!view) return S_FALSE;
+  const Header* header = (const Header*)view;
+  const TypeRecord* types = (const TypeRecord*)(header + 1);
+  const MemberRecord* members = (const MemberRecord*)(types + header->typeCount);
+  const ParamRecord* params = (const ParamRecord*)(members + header->memberCount);
+  const wchar_t* names = (const wchar_t*)(params + header->paramCount);
+
+  DWORD lo = 0, hi = header->typeCount;
+  while (lo < hi)
+  {
+    DWORD mid = lo + (hi - lo) / 2;
+    if (compareType(types[mid].guid, types[mid].kind, guid, kind) < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  if (lo == header->typeCount || compareType(types[lo].guid, types[lo].kind, guid, kind)) return S_FALSE;
+  const TypeRecord& rec = types[lo];
+  if (rec.firstMember > header->memberCount || rec.memberCount > header->memberCount - rec.firstMember
+    || rec.name > header->nameChars || rec.nameLength > header->nameChars - rec.name) return S_FALSE;
+
+  type.typeName.assign(names + rec.name, rec.nameLength);
+  type.hasDefaultProp = (rec.flags & tf_HasDefaultProp) != 0;
+  type.members.clear();
+  type.signatures.clear();
+  for (DWORD i = 0; i < rec.memberCount; ++i)
+  {
+    const MemberRecord& mrec = members[rec.firstMember + i];
+    if (mrec.name > header->nameChars || mrec.nameLength > header->nameChars - mrec.name) continue;
+    MemberInfo info;
+    info.memberID = mrec.memberID;
+    info.attrs = (int)mrec.attrs;
+    info.vt = mrec.vt;
+    if (mrec.paramCount >= 0 && mrec.firstParam <= header->paramCount && (DWORD)mrec.paramCount <= header->paramCount - mrec.firstParam)
+    {
+      ParamInfo* pinfo = mrec.paramCount ? type.allocParams(mrec.paramCount) : NULL;
+      for (SHORT p = 0; p < mrec.paramCount; ++p)
+      {
+        pinfo[p].vt = params[mrec.firstParam + p].vt;
+        pinfo[p].flags = params[mrec.firstParam + p].flags;
+      }
+      info.params = pinfo;
+      info.paramCount = mrec.paramCount;
+      info.requiredCount = mrec.requiredCount;
+    }
+    type.members.insert(OCTypeMembers::TMemberMap::value_type(wstring(names + mrec.name, mrec.nameLength), info));
+  }
+  type.index.build(type.members);
+  type.memberCount = (int)type.members.size();
+  type.complete = true;
+  return S_OK;
+}
+
+HRESULT OCTypeIndex::build(ITypeLib* tlib, const wstring& path, const Header& stamp)
+{
+  vector<TypeRecord> types;
+  vector<MemberRecord> members;
+  vector<ParamRecord> params;
+  wstring names;
+
+  // only interfaces are ever handed out by IDispatch::GetTypeInfo
+  UINT count = tlib->GetTypeInfoCount();
+  for (UINT i = 0; i < count; ++i)
+  {
+    TYPEKIND kind;
+    if (FAILED(tlib->GetTypeInfoType(i, &kind)) || (kind != TKIND_DISPATCH && kind != TKIND_INTERFACE)) continue;
+    ITypeInfo* tinfo;
+    if (FAILED(tlib->GetTypeInfo(i, &tinfo))) continue;
+    TYPEATTR* tattr;
+    if (SUCCEEDED(tinfo->GetTypeAttr(&tattr)))
+    {
+      TypeRecord rec;
+      rec.guid = tattr->guid;
+      rec.kind = tattr->typekind;
+      tinfo->ReleaseTypeAttr(tattr);
+
+      OCTypeMembers* type = new OCTypeMembers();
+      if (!IsEqualGUID(rec.guid, GUID_NULL) && SUCCEEDED(type->interrogate(tinfo)))
+      {
+        rec.flags = type->hasDefaultProp ? tf_HasDefaultProp : 0;
+        rec.name = (DWORD)names.length();
+        rec.nameLength = (DWORD)type->typeName.length();
+        names += type->typeName;
+        rec.firstMember = (DWORD)members.size();
+        rec.memberCount = (DWORD)type->members.size();
+        for (OCTypeMembers::TMemberMap::const_iterator trans = type->members.begin(); trans != type->members.end(); trans++)
+        {
+          MemberRecord mrec;
+          mrec.memberID = trans->second.memberID;
+          mrec.attrs = (DWORD)trans->second.attrs;
+          mrec.name = (DWORD)names.length();
+          mrec.nameLength = (DWORD)trans->first.length();
+          names += trans->first;
+          const MemberInfo& info = trans->second;
+          mrec.vt = info.vt;
+          mrec.paramCount = info.paramCount;
+          mrec.requiredCount = info.requiredCount;
+          mrec.reserved = 0;
+          mrec.firstParam = (DWORD)params.size();
+          for (short p = 0; p < info.paramCount; ++p)
+          {
+            ParamRecord prec;
+            prec.vt = info.params[p].vt;
+            prec.flags = info.params[p].flags;
+            params.push_back(prec);
+          }
+          members.push_back(mrec);
+        }
+        types.push_back(rec);
+      }
+      type->Release();
+    }
+    tinfo->Release();
+  }
+  std::sort(types.begin(), types.end(), TypeRecordLess());
+
+  Header header = stamp;
+  header.typeCount = (DWORD)types.size();
+  header.memberCount = (DWORD)members.size();
+  header.paramCount = (DWORD)params.size();
+  header.nameChars = (DWORD)names.length();
+
+  // write next to the real file and move it into place, other processes may be mapping the old one
+  wchar_t szSuffix[16];
+  swprintf_s(szSuffix, L".%lu", GetCurrentProcessId());
+  wstring tempPath = path + szSuffix;
+  HANDLE file = CreateFileW(tempPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) return HRESULT_FROM_WIN32(GetLastError());
+  DWORD written;
+  BOOL bWritten = WriteFile(file, &header, sizeof(header), &written, NULL)
+    && (types.empty() || WriteFile(file, &types[0], (DWORD)(types.size() * sizeof(TypeRecord)), &written, NULL))
+    && (members.empty() || WriteFile(file, &members[0], (DWORD)(members.size() * sizeof(MemberRecord)), &written, NULL))
+    && (params.empty() || WriteFile(file, &params[0], (DWORD)(params.size() * sizeof(ParamRecord)), &written, NULL))
+    && (names.empty() || WriteFile(file, names.c_str(), (DWORD)(names.length() * sizeof(wchar_t)), &written, NULL));
+  HRESULT hr = bWritten ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+  CloseHandle(file);
+  if (SUCCEEDED(hr) && !MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) hr = HRESULT_FROM_WIN32(GetLastError());
+  if (FAILED(hr)) DeleteFileW(tempPath.c_str());
+  return hr;
+}
+
+} // namespace ole32core
@@ -0,0 +1,43 @@
+#ifndef __OLETYPEINDEX_H__
+#define __OLETYPEINDEX_H__
+
+#include <map>
+#include "ole32core.h"
+#include "oletypeinfo.h"
+
+namespace ole32core {
+
+// A read-only, memory mapped file holding the member tables of every interface in one type library,
+// so later processes can fill an OCTypeMembers without walking the ITypeInfo again.
+// Files are named after the library GUID, version, LCID and SYSKIND and stamped with the time and size
+// of the library they were built from, an index that doesn't match is rebuilt.
+class OCTypeIndex : public OCRefCounted {
+public:
+  struct Header;
+  struct TypeRecord;
+  struct MemberRecord;
+  // returns an AddRef'ed index of the library containing tinfo, building it first if it is missing or stale.
+  // S_FALSE with NULL if indexing is disabled or the library can't be indexed (e.g. it isn't registered)
+  static HRESULT open(ITypeInfo* tinfo, OCTypeIndex** ppIndex);
+  // fills the table with the recorded members of this type, S_FALSE if the index doesn't have it
+  HRESULT load(REFGUID guid, TYPEKIND kind, OCTypeMembers& type) const;
+  // where index files are kept, empty to disable indexing (the default)
+  static void setDirectory(const std::wstring& dir);
+  static std::wstring getDirectory();
+protected:
+  OCTypeIndex();
+  ~OCTypeIndex();
+  bool map(const std::wstring& path, const Header& stamp);
+  void unmap();
+  static HRESULT build(ITypeLib* tlib, const std::wstring& path, const Header& stamp);
+  HANDLE mapping;
+  const BYTE* view;
+  DWORD viewSize;
+private:
+  OCTypeIndex(const OCTypeIndex&); // not copyable
+  OCTypeIndex& operator=(const OCTypeIndex&);
+};
+
+} // namespace ole32core
+
+#endif // __OLETYPEINDEX_H__
@@ -0,0 +1,736 @@
+/*
+  oletypeinfo.cpp
+  This source is independent of node/v8.
+*/
+
+#include "oletypeinfo.h"
+#include "oletypeindex.h"
+#include <cwctype>
+
+using namespace std;
+
+namespace ole32core {
+
+static inline wchar_t foldChar(wchar_t c)
+{
+  if (c < 0x80) return (c >= L'A' && c <= L'Z') ? (wchar_t)(c + (L'a' - L'A')) : c;
+  return (wchar_t)towlower(c);
+}
+
+ULONG OCMemberIndex::hashName(const wchar_t* name, size_t len)
+{
+  ULONG hash = 2166136261UL; // FNV-1a
+  for (size_t i = 0; i < len; ++i)
+  {
+    hash ^= (ULONG)foldChar(name[i]);
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+void OCMemberIndex::build(const TMemberMap& members)
+{
+  // every property may add a get_ and put_ variant
+  slots.clear();
+  mask = 0;
+  count = 0;
+  reserve(members.size() * 3);
+
+  TMemberMap::const_iterator trans;
+  for (trans = members.begin(); trans != members.end(); trans++)
+  {
+    add(*trans);
+  }
+}
+
+void OCMemberIndex::add(const TMemberMap::value_type& entry)
+{
+  reserve(count + 3);
+  insert(entry.first, entry.first, entry.second, mk_Member);
+  if (entry.second.attrs & ma_IsProperty)
+  {
+    insert(L"get_" + entry.first, entry.first, entry.second, mk_PropertyGet);
+    insert(L"put_" + entry.first, entry.first, entry.second, mk_PropertyPut);
+  }
+}
+
+void OCMemberIndex::reserve(size_t entries)
+{
+  // keep the load factor under one half so a probe sequence always ends on an empty slot
+  size_t capacity = slots.empty() ? 8 : slots.size();
+  while (capacity < entries * 2) capacity <<= 1;
+  if (capacity == slots.size()) return;
+
+  std::vector<Slot> old(capacity);
+  old.swap(slots);
+  mask = (ULONG)(capacity - 1);
+  count = 0;
+  for (size_t i = 0; i < old.size(); ++i)
+  {
+    if (old[i].ref.member) insertSlot(old[i]);
+  }
+}
+
+void OCMemberIndex::insert(const wstring& key, const wstring& name, const MemberInfo& member, int kind)
+{
+  wstring folded(key);
+  for (size_t i = 0; i < folded.length(); ++i) folded[i] = foldChar(folded[i]);
+  ULONG hash = hashName(key.c_str(), key.length());
+  ULONG idx = hash & mask;
+  while (slots[idx].ref.member)
+  {
+    Slot& slot = slots[idx];
+    if (slot.hash == hash && slot.key == folded)
+    {
+      // a type that declares something called "get_Foo" itself wins over the prefixed "Foo",
+      // whichever of the two was added first
+      if (kind == mk_Member && slot.ref.kind != mk_Member)
+      {
+        slot.ref.name = &name;
+        slot.ref.member = &member;
+        slot.ref.kind = kind;
+      }
+      return;
+    }
+    idx = (idx + 1) & mask;
+  }
+  Slot& slot = slots[idx];
+  slot.hash = hash;
+  slot.key.swap(folded);
+  slot.ref.name = &name;
+  slot.ref.member = &member;
+  slot.ref.kind = kind;
+  ++count;
+}
+
+void OCMemberIndex::insertSlot(Slot& from)
+{
+  ULONG idx = from.hash & mask;
+  while (slots[idx].ref.member) idx = (idx + 1) & mask;
+  Slot& slot = slots[idx];
+  slot.hash = from.hash;
+  slot.key.swap(from.key);
+  slot.ref = from.ref;
+  ++count;
+}
+
+bool OCMemberIndex::find(const wchar_t* name, size_t len, MemberRef& result) const
+{
+  if (slots.empty()) return false;
+  ULONG hash = hashName(name, len);
+  ULONG idx = hash & mask;
+  while (slots[idx].ref.member)
+  {
+    const Slot& slot = slots[idx];
+    if (slot.hash == hash && slot.key.length() == len)
+    {
+      size_t pos = 0;
+      while (pos < len && slot.key[pos] == foldChar(name[pos])) ++pos;
+      if (pos == len)
+      {
+        result = slot.ref;
+        return true;
+      }
+    }
+    idx = (idx + 1) & mask;
+  }
+  return false;
+}
+
+VARTYPE resolveVarType(ITypeInfo* tinfo, const TYPEDESC& tdesc)
+{
+  switch (tdesc.vt)
+  {
+  case VT_PTR:
+    {
+      VARTYPE vt = resolveVarType(tinfo, *tdesc.lptdesc);
+      // "Foo*" is how an interface is passed, anything else behind a pointer is by reference
+      if (tdesc.lptdesc->vt == VT_USERDEFINED && (vt == VT_DISPATCH || vt == VT_UNKNOWN)) return vt;
+      return (VARTYPE)(vt | VT_BYREF);
+    }
+  case VT_SAFEARRAY:
+    return (VARTYPE)(resolveVarType(tinfo, *tdesc.lptdesc) | VT_ARRAY);
+  case VT_USERDEFINED:
+    {
+      ITypeInfo* refInfo;
+      if (FAILED(tinfo->GetRefTypeInfo(tdesc.hreftype, &refInfo))) return VT_VARIANT;
+      VARTYPE vt = VT_VARIANT;
+      TYPEATTR* tattr;
+      if (SUCCEEDED(refInfo->GetTypeAttr(&tattr)))
+      {
+        switch (tattr->typekind)
+        {
+        case TKIND_ENUM: vt = VT_I4; break;
+        case TKIND_ALIAS: vt = resolveVarType(refInfo, tattr->tdescAlias); break;
+        case TKIND_DISPATCH: case TKIND_COCLASS: vt = VT_DISPATCH; break;
+        case TKIND_INTERFACE: vt = (tattr->wTypeFlags & TYPEFLAG_FDISPATCHABLE) ? VT_DISPATCH : VT_UNKNOWN; break;
+        case TKIND_RECORD: vt = VT_RECORD; break;
+        default: break;
+        }
+        refInfo->ReleaseTypeAttr(tattr);
+      }
+      refInfo->Release();
+      return vt;
+    }
+  default:
+    return tdesc.vt;
+  }
+}
+
+// below this many declared members a type is interrogated in full, binding one name at a time only pays off for big interfaces
+static const int LAZY_BIND_MIN_MEMBERS = 32;
+// misses remembered per table, a script probing many names would grow the set forever otherwise;
+// when full it starts over, a forgotten miss only costs another Bind
+static const size_t MAX_UNKNOWN_NAMES = 1024;
+
+static const INVOKEKIND invokeKinds[] = { INVOKE_FUNC, INVOKE_PROPERTYGET, INVOKE_PROPERTYPUT, INVOKE_PROPERTYPUTREF };
+
+static void readTypeName(ITypeInfo* tinfo, wstring& typeName)
+{
+  BSTR bTypeName;
+  HRESULT hr = tinfo->GetDocumentation(MEMBERID_NIL, &bTypeName, NULL, NULL, NULL);
+  if (SUCCEEDED(hr))
+  {
+    typeName = wstring(bTypeName, SysStringLen(bTypeName));
+    SysFreeString(bTypeName);
+  }
+}
+
+OCTypeMembers::OCTypeMembers() : hasDefaultProp(false), shared(false), memberCount(0), complete(true),
+  tinfo(NULL), tcomp(NULL), syskind(SYS_WIN32), lcid(LOCALE_USER_DEFAULT)
+{
+}
+
+OCTypeMembers::~OCTypeMembers()
+{
+  detach();
+}
+
+HRESULT OCTypeMembers::interrogate(ITypeInfo* typeInfo)
+{
+  // pull this object type
+  readTypeName(typeInfo, typeName);
+
+  hasDefaultProp = false;
+  members.clear();
+  signatures.clear();
+  HRESULT hr = readMembers(typeInfo);
+  if (FAILED(hr)) return hr; // can't really recover from this one
+
+  index.build(members);
+  memberCount = (int)members.size();
+  complete = true;
+  return S_OK;
+}
+
+HRESULT OCTypeMembers::prepare(ITypeInfo* typeInfo)
+{
+  TYPEATTR* tattr;
+  HRESULT hr = typeInfo->GetTypeAttr(&tattr);
+  if (FAILED(hr)) return hr;
+  int declared = tattr->cFuncs + tattr->cVars;
+  lcid = tattr->lcid;
+  typeInfo->ReleaseTypeAttr(tattr);
+
+  if (declared >= LAZY_BIND_MIN_MEMBERS && SUCCEEDED(typeInfo->QueryInterface(IID_ITypeInfo2, (void**)&tinfo)))
+  {
+    if (FAILED(tinfo->GetTypeComp(&tcomp))) tcomp = NULL;
+  }
+  if (!tcomp)
+  {
+    detach();
+    hr = interrogate(typeInfo);
+    return FAILED(hr) ? hr : S_FALSE;
+  }
+
+  readTypeName(tinfo, typeName);
+
+  // Bind wants the name hashed the way the containing library hashed it
+  ITypeLib* tlib;
+  UINT tindex;
+  if (SUCCEEDED(tinfo->GetContainingTypeLib(&tlib, &tindex)))
+  {
+    TLIBATTR* lattr;
+    if (SUCCEEDED(tlib->GetLibAttr(&lattr)))
+    {
+      syskind = lattr->syskind;
+      lcid = lattr->lcid;
+      tlib->ReleaseTLibAttr(lattr);
+    }
+    tlib->Release();
+  }
+
+  // the default property decides how valueOf and indexing behave, so it's needed right away
+  hasDefaultProp = false;
+  UINT idx;
+  for (int i = 0; i < (int)(sizeof(invokeKinds) / sizeof(invokeKinds[0])) && !hasDefaultProp; ++i)
+  {
+    hasDefaultProp = SUCCEEDED(tinfo->GetFuncIndexOfMemId(DISPID_VALUE, invokeKinds[i], &idx));
+  }
+  if (!hasDefaultProp) hasDefaultProp = SUCCEEDED(tinfo->GetVarIndexOfMemId(DISPID_VALUE, &idx));
+
+  members.clear();
+  memberCount = declared;
+  complete = false;
+  return S_OK;
+}
+
+HRESULT OCTypeMembers::enumerate()
+{
+  if (complete) return S_OK;
+  OCAutoLock lock(bindLock);
+  if (complete) return S_OK;
+  if (!tinfo) return S_FALSE; // detached, all we have is what was bound so far
+
+  HRESULT hr = readMembers(tinfo);
+  if (FAILED(hr)) return hr;
+  for (TMemberMap::const_iterator trans = members.begin(); trans != members.end(); trans++)
+  {
+    index.add(*trans);
+  }
+  complete = true;
+  detach();
+  return S_OK;
+}
+
+void OCTypeMembers::detach()
+{
+  OCAutoLock lock(bindLock);
+  if (tcomp)
+  {
+    tcomp->Release();
+    tcomp = NULL;
+  }
+  if (tinfo)
+  {
+    tinfo->Release();
+    tinfo = NULL;
+  }
+  unknown.clear(); // nothing is bound any more, so there is nothing to save
+}
+
+bool OCTypeMembers::find(const wchar_t* name, size_t len, MemberRef& result)
+{
+  if (complete) return index.find(name, len, result);
+
+  OCAutoLock lock(bindLock);
+  bool found = index.find(name, len, result);
+  if (found && result.kind == mk_Member) return true;
+  wstring key(name, len);
+  if (unknown.find(key) != unknown.end()) return found;
+
+  // even if the prefix matched, a member declared as "get_Foo" would win over the accessor of "Foo"
+  if (bind(name, len)) return index.find(name, len, result);
+  if (!found && len > 4 && (!_wcsnicmp(name, L"get_", 4) || !_wcsnicmp(name, L"put_", 4)))
+  {
+    if (bind(name + 4, len - 4)) found = index.find(name, len, result);
+  }
+  if (!tcomp) return found;
+  if (unknown.size() >= MAX_UNKNOWN_NAMES) unknown.clear();
+  unknown.insert(key);
+  return found;
+}
+
+bool OCTypeMembers::bind(const wchar_t* name, size_t len)
+{
+  if (!tcomp) return false;
+  wstring szName(name, len); // Bind wants a writable, NUL terminated name
+  ULONG hash = LHashValOfNameSys(syskind, lcid, szName.c_str());
+
+  ITypeInfo* bindInfo = NULL;
+  DESCKIND desckind = DESCKIND_NONE;
+  BINDPTR bindptr;
+  HRESULT hr = tcomp->Bind(&szName[0], hash, 0, &bindInfo, &desckind, &bindptr);
+  if (FAILED(hr)) return false;
+
+  MEMBERID memid = MEMBERID_NIL;
+  switch (desckind)
+  {
+  case DESCKIND_FUNCDESC:
+    memid = bindptr.lpfuncdesc->memid;
+    bindInfo->ReleaseFuncDesc(bindptr.lpfuncdesc);
+    break;
+  case DESCKIND_VARDESC:
+  case DESCKIND_IMPLICITAPPOBJ:
+    memid = bindptr.lpvardesc->memid;
+    bindInfo->ReleaseVarDesc(bindptr.lpvardesc);
+    break;
+  case DESCKIND_TYPECOMP:
+    bindptr.lptcomp->Release();
+    break;
+  default:
+    break;
+  }
+  if (bindInfo) bindInfo->Release();
+
+  // Bind also searches base interfaces, readMember only accepts what interrogate() would have found
+  return memid != MEMBERID_NIL && readMember(memid) == S_OK;
+}
+
+HRESULT OCTypeMembers::readMember(MEMBERID memid)
+{
+  BSTR bMemName;
+  UINT numNames;
+  HRESULT hr = tinfo->GetNames(memid, &bMemName, 1, &numNames);
+  if (FAILED(hr)) return hr;
+  wstring memberName(bMemName, SysStringLen(bMemName));
+  SysFreeString(bMemName);
+  if (members.find(memberName) != members.end()) return S_OK; // already indexed
+
+  // a property is spread over several FUNCDESCs, collect all of them so the attributes are complete
+  TMemberMap::iterator entry = members.end();
+  UINT idx;
+  for (int i = 0; i < (int)(sizeof(invokeKinds) / sizeof(invokeKinds[0])); ++i)
+  {
+    FUNCDESC *funcdesc;
+    if (FAILED(tinfo->GetFuncIndexOfMemId(memid, invokeKinds[i], &idx))) continue;
+    if (FAILED(tinfo->GetFuncDesc(idx, &funcdesc))) continue;
+    if (!(funcdesc->wFuncFlags & FUNCFLAG_FRESTRICTED)) entry = addFunc(memberName, funcdesc, tinfo);
+    tinfo->ReleaseFuncDesc(funcdesc);
+  }
+  if (entry == members.end() && SUCCEEDED(tinfo->GetVarIndexOfMemId(memid, &idx)))
+  {
+    VARDESC *vardesc;
+    if (SUCCEEDED(tinfo->GetVarDesc(idx, &vardesc)))
+    {
+      if (!(vardesc->wVarFlags & VARFLAG_FRESTRICTED)) entry = addVar(memberName, vardesc, tinfo);
+      tinfo->ReleaseVarDesc(vardesc);
+    }
+  }
+  if (entry == members.end()) return S_FALSE;
+  index.add(*entry);
+  return S_OK;
+}
+
+HRESULT OCTypeMembers::readMembers(ITypeInfo* typeInfo)
+{
+  TYPEATTR* tattr;
+  HRESULT hr = typeInfo->GetTypeAttr(&tattr);
+  if (FAILED(hr)) return hr;
+
+  BSTR bMemName;
+  UINT numNames;
+
+  // pull functions and properties
+  for (int i = 0; i < tattr->cFuncs; ++i) {
+    FUNCDESC *funcdesc;
+    hr = typeInfo->GetFuncDesc(i, &funcdesc);
+    if(SUCCEEDED(hr))
+    {
+      if (funcdesc->memid == DISPID_VALUE) hasDefaultProp = true;
+      if(!(funcdesc->wFuncFlags & FUNCFLAG_FRESTRICTED))
+      {
+        hr = typeInfo->GetNames(funcdesc->memid, &bMemName, 1, &numNames);
+        if (SUCCEEDED(hr))
+        {
+          wstring memberName(bMemName, SysStringLen(bMemName));
+          SysFreeString(bMemName);
+          addFunc(memberName, funcdesc, typeInfo);
+        }
+      }
+      typeInfo->ReleaseFuncDesc(funcdesc);
+    }
+  }
+
+  for (int i = 0; i < tattr->cVars; ++i) {
+    VARDESC *vardesc;
+    hr = typeInfo->GetVarDesc(i, &vardesc);
+    if (SUCCEEDED(hr))
+    {
+      if (vardesc->memid == DISPID_VALUE) hasDefaultProp = true;
+      if(!(vardesc->wVarFlags & VARFLAG_FRESTRICTED))
+      {
+        hr = typeInfo->GetNames(vardesc->memid, &bMemName, 1, &numNames);
+        if (SUCCEEDED(hr))
+        {
+          wstring memberName(bMemName, SysStringLen(bMemName));
+          SysFreeString(bMemName);
+          addVar(memberName, vardesc, typeInfo);
+        }
+      }
+      typeInfo->ReleaseVarDesc(vardesc);
+    }
+  }
+
+  typeInfo->ReleaseTypeAttr(tattr);
+  return S_OK;
+}
+
+OCTypeMembers::TMemberMap::iterator OCTypeMembers::addFunc(const wstring& memberName, const FUNCDESC* funcdesc, ITypeInfo* typeInfo)
+{
+  TMemberMap::iterator lookup = members.find(memberName);
+  if (lookup == members.end())
+  {
+    lookup = members.insert(TMemberMap::value_type(memberName, MemberInfo())).first;
+    MemberInfo& info = lookup->second;
+    info.memberID = funcdesc->memid;
+    info.attrs = ma_IsReadOnly;
+    if (funcdesc->invkind != INVOKE_FUNC) info.attrs |= ma_IsProperty;
+    if (funcdesc->wFuncFlags & (FUNCFLAG_FHIDDEN | FUNCFLAG_FNONBROWSABLE)) info.attrs |= ma_IsHidden;
+  }
+  MemberInfo& info = lookup->second;
+  if (info.memberID == funcdesc->memid)
+  {
+    if (funcdesc->invkind == INVOKE_PROPERTYPUT || funcdesc->invkind == INVOKE_PROPERTYPUTREF) info.attrs &= ~ma_IsReadOnly;
+    if (funcdesc->invkind == INVOKE_PROPERTYGET && funcdesc->cParams) info.attrs |= ma_IsIndexedProperty;
+    if (info.paramCount < 0)
+    {
+      if (funcdesc->invkind == INVOKE_FUNC || funcdesc->invkind == INVOKE_PROPERTYGET)
+      {
+        readSignature(info, funcdesc, typeInfo);
+      }
+      else if (funcdesc->cParams)
+      {
+        // a write-only property, all we need is the type of the value
+        info.vt = resolveVarType(typeInfo, funcdesc->lprgelemdescParam[funcdesc->cParams - 1].tdesc);
+      }
+    }
+  }
+  return lookup;
+}
+
+OCTypeMembers::TMemberMap::iterator OCTypeMembers::addVar(const wstring& memberName, const VARDESC* vardesc, ITypeInfo* typeInfo)
+{
+  TMemberMap::iterator lookup = members.find(memberName);
+  if (lookup == members.end())
+  {
+    lookup = members.insert(TMemberMap::value_type(memberName, MemberInfo())).first;
+    MemberInfo& info = lookup->second;
+    info.memberID = vardesc->memid;
+    info.attrs = ma_IsProperty;
+    if (vardesc->wVarFlags & VARFLAG_FREADONLY) info.attrs |= ma_IsReadOnly;
+    if (vardesc->wVarFlags & (VARFLAG_FHIDDEN | VARFLAG_FNONBROWSABLE)) info.attrs |= ma_IsHidden;
+    info.vt = resolveVarType(typeInfo, vardesc->elemdescVar.tdesc);
+    info.paramCount = 0;
+  }
+  return lookup;
+}
+
+void OCTypeMembers::readSignature(MemberInfo& info, const FUNCDESC* funcdesc, ITypeInfo* typeInfo)
+{
+  ParamInfo* params = funcdesc->cParams ? allocParams(funcdesc->cParams) : NULL;
+  short count = 0, required = 0;
+  info.vt = resolveVarType(typeInfo, funcdesc->elemdescFunc.tdesc);
+  for (SHORT i = 0; i < funcdesc->cParams; ++i)
+  {
+    const ELEMDESC& elemdesc = funcdesc->lprgelemdescParam[i];
+    USHORT pflags = elemdesc.paramdesc.wParamFlags;
+    if (pflags & PARAMFLAG_FRETVAL)
+    {
+      // what a dual interface really returns
+      info.vt = resolveVarType(typeInfo, elemdesc.tdesc) & ~VT_BYREF;
+      continue;
+    }
+    if (pflags & PARAMFLAG_FLCID) continue; // filled in by IDispatch, never passed by the caller
+    ParamInfo& param = params[count++];
+    param.vt = resolveVarType(typeInfo, elemdesc.tdesc);
+    param.flags = 0;
+    if (pflags & PARAMFLAG_FHASDEFAULT) param.flags |= pf_HasDefault;
+    if (pflags & PARAMFLAG_FOUT) param.flags |= pf_Out;
+    // cParamsOpt counts trailing VARIANTs that may be left out, -1 makes the last one a vararg array
+    if ((pflags & PARAMFLAG_FOPT) || (funcdesc->cParamsOpt > 0 && i >= funcdesc->cParams - funcdesc->cParamsOpt)
+      || (funcdesc->cParamsOpt == -1 && i == funcdesc->cParams - 1)) param.flags |= pf_Optional;
+    if (!(param.flags & (pf_Optional | pf_HasDefault))) required = count;
+  }
+  if (funcdesc->cParamsOpt == -1) info.attrs |= ma_VarArg;
+  info.params = params;
+  info.requiredCount = required;
+  info.paramCount = count; // last, find() may be reading this entry from another thread
+}
+
+ParamInfo* OCTypeMembers::allocParams(size_t count)
+{
+  signatures.push_back(std::vector<ParamInfo>(count));
+  return &signatures.back()[0];
+}
+
+namespace {
+
+struct TypeKey
+{
+  GUID guid;
+  LCID lcid;
+  TYPEKIND kind;
+  bool operator<(const TypeKey& other) const
+  {
+    int cmp = memcmp(&guid, &other.guid, sizeof(GUID));
+    if (cmp) return cmp < 0;
+    if (lcid != other.lcid) return lcid < other.lcid;
+    return kind < other.kind;
+  }
+};
+
+typedef OCSharedCache<TypeKey, OCTypeMembers> TTypeCache;
+
+TTypeCache cacheEntries;
+LONG cacheHits = 0;
+LONG cacheMisses = 0;
+LONG cacheIndexed = 0;
+
+} // namespace
+
+HRESULT OCTypeCache::lookup(ITypeInfo* tinfo, LCID lcid, bool lazy, OCTypeMembers** ppType)
+{
+  if (!ppType) return E_POINTER;
+  *ppType = NULL;
+  if (!tinfo) return S_FALSE;
+
+  TYPEATTR* tattr;
+  HRESULT hr = tinfo->GetTypeAttr(&tattr);
+  if (FAILED(hr)) return hr;
+  TypeKey key;
+  key.guid = tattr->guid;
+  key.lcid = lcid;
+  key.kind = tattr->typekind;
+  tinfo->ReleaseTypeAttr(tattr);
+
+  // types without an identity (GUID_NULL) can't be shared, every object gets a private table
+  bool bShareable = !IsEqualGUID(key.guid, GUID_NULL);
+  if (bShareable)
+  {
+    if (cacheEntries.find(key, ppType))
+    {
+      InterlockedIncrement(&cacheHits);
+      return S_OK;
+    }
+    InterlockedIncrement(&cacheMisses);
+  }
+
+  // interrogate outside the lock, this may call out of process
+  OCTypeMembers* type = new OCTypeMembers();
+  hr = S_FALSE;
+  OCTypeIndex* tindex = NULL;
+  if (bShareable && OCTypeIndex::open(tinfo, &tindex) == S_OK)
+  {
+    hr = tindex->load(key.guid, key.kind, *type);
+    tindex->Release();
+    if (hr == S_OK) InterlockedIncrement(&cacheIndexed);
+  }
+  if (hr != S_OK) hr = lazy ? type->prepare(tinfo) : type->interrogate(tinfo);
+  if (FAILED(hr))
+  {
+    type->Release();
+    return hr;
+  }
+  if (type->empty())
+  {
+    // nothing useful here, remember that so we fall back to IDispatch::GetIDsOfNames
+    type->Release();
+    type = NULL;
+  }
+
+  if (bShareable)
+  {
+    if (type) type->shared = true;
+    type = cacheEntries.insert(key, type);
+  }
+  *ppType = type;
+  return S_OK;
+}
+
+void OCTypeCache::getStats(Stats& stats)
+{
+  stats.hits = (ULONG)cacheHits;
+  stats.misses = (ULONG)cacheMisses;
+  stats.entries = (ULONG)cacheEntries.size();
+  stats.indexed = (ULONG)cacheIndexed;
+}
+
+void OCTypeCache::clear()
+{
+  TTypeCache::TEntryMap entries;
+  cacheEntries.take(entries);
+  // objects still holding one of these tables keep whatever members were bound so far
+  for (TTypeCache::TEntryMap::iterator trans = entries.begin(); trans != entries.end(); trans++)
+  {
+    if (!trans->second) continue;
+    trans->second->detach();
+    trans->second->Release();
+  }
+}
+
+namespace {
+
+struct ClsidLess
+{
+  bool operator()(const CLSID& left, const CLSID& right) const
+  {
+    return memcmp(&left, &right, sizeof(CLSID)) < 0;
+  }
+};
+
+OCSharedCache<CLSID, OCNameCache, ClsidLess> sharedNames;
+LONG nameHits = 0;
+LONG nameMisses = 0;
+
+// failed names are whatever scripts probe for, so only this many are remembered per cache
+const size_t MAX_NEGATIVE_NAMES = 1024;
+
+} // namespace
+
+OCNameCache::OCNameCache(bool n) : negative(n), negatives(0)
+{
+}
+
+HRESULT OCNameCache::find(const wchar_t* name, size_t len, DISPID* pid)
+{
+  OCAutoLock lock(namesLock);
+  TNameMap::const_iterator found = names.find(wstring(name, len));
+  if (found == names.end())
+  {
+    InterlockedIncrement(&nameMisses);
+    return S_FALSE;
+  }
+  InterlockedIncrement(&nameHits);
+  if (found->second == DISPID_UNKNOWN) return DISP_E_UNKNOWNNAME;
+  *pid = found->second;
+  return S_OK;
+}
+
+void OCNameCache::insert(const wchar_t* name, size_t len, HRESULT hr, DISPID id)
+{
+  if (FAILED(hr))
+  {
+    // only a definite "no such name" is worth remembering, anything else may be transient
+    if (hr != DISP_E_UNKNOWNNAME || !negative) return;
+    id = DISPID_UNKNOWN;
+  }
+  OCAutoLock lock(namesLock);
+  if (id == DISPID_UNKNOWN && negatives >= MAX_NEGATIVE_NAMES)
+  {
+    for (TNameMap::iterator it = names.begin(); it != names.end();)
+    {
+      if (it->second == DISPID_UNKNOWN) names.erase(it++);
+      else ++it;
+    }
+    negatives = 0;
+  }
+  std::pair<TNameMap::iterator, bool> inserted = names.insert(TNameMap::value_type(wstring(name, len), id));
+  if (!inserted.second)
+  {
+    if (inserted.first->second == DISPID_UNKNOWN) --negatives;
+    inserted.first->second = id;
+  }
+  if (id == DISPID_UNKNOWN) ++negatives;
+}
+
+OCNameCache* OCNameCache::getShared(REFCLSID clsid)
+{
+  OCNameCache* cache;
+  if (sharedNames.find(clsid, &cache)) return cache;
+  return sharedNames.insert(clsid, new OCNameCache());
+}
+
+void OCNameCache::getStats(Stats& stats)
+{
+  stats.hits = (ULONG)nameHits;
+  stats.misses = (ULONG)nameMisses;
+  stats.shared = (ULONG)sharedNames.size();
+}
+
+void OCNameCache::clearShared()
+{
+  sharedNames.clear();
+}
+
+} // namespace ole32core
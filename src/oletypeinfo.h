@@ -0,0 +1,203 @@
+#ifndef __OLETYPEINFO_H__
+#define __OLETYPEINFO_H__
+
+#include <functional>
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+#include "ole32core.h"
+
+namespace ole32core {
+
+enum EMemberAttr
+{
+  ma_IsProperty = 1,
+  ma_IsIndexedProperty = 2,
+  ma_IsReadOnly = 4,
+  ma_IsHidden = 8,
+  ma_VarArg = 16 // any number of arguments may follow the declared ones
+};
+
+enum EParamFlags
+{
+  pf_Optional = 1,
+  pf_HasDefault = 2,
+  pf_Out = 4
+};
+
+struct ParamInfo
+{
+  VARTYPE vt; // as passed through IDispatch, see resolveVarType
+  USHORT flags; // EParamFlags
+};
+
+struct MemberInfo
+{
+  MemberInfo() : memberID(DISPID_UNKNOWN), attrs(0), vt(VT_VARIANT), paramCount(-1), requiredCount(0), params(NULL) {}
+  DISPID memberID;
+  int attrs;
+  VARTYPE vt; // the type of a property, or what a method returns
+  short paramCount; // parameters of the method or property get, -1 if the signature is unknown
+  short requiredCount; // leading parameters that can't be omitted
+  const ParamInfo* params; // paramCount entries, owned by the member table
+};
+
+// the VARTYPE a TYPEDESC is passed as through IDispatch, aliases and enums are resolved through tinfo
+extern VARTYPE resolveVarType(ITypeInfo* tinfo, const TYPEDESC& tdesc);
+
+// how a name resolved against a member table, "get_" and "put_" name the accessors of a property
+enum EMemberKind
+{
+  mk_Member = 0,
+  mk_PropertyGet = 1,
+  mk_PropertyPut = 2
+};
+
+struct MemberRef
+{
+  const std::wstring* name; // the member name as declared by the type
+  const MemberInfo* member; // NULL if the name is not a member
+  int kind;
+};
+
+struct CaseInsensitive : public std::binary_function<std::wstring, std::wstring, bool>
+{
+  bool operator()(const std::wstring& left, const std::wstring& right) const
+  {
+    return wcsicmp(left.c_str(), right.c_str()) < 0;
+  }
+};
+
+// Case-folded open-addressing hash over a member map, the get_/put_ variants of every
+// property are inserted alongside it so a lookup is always a single probe sequence.
+// Only pointers into the member map are kept, so it must outlive the index.
+class OCMemberIndex {
+public:
+  typedef std::map<std::wstring, MemberInfo, CaseInsensitive> TMemberMap;
+  OCMemberIndex() : mask(0), count(0) {}
+  void build(const TMemberMap& members);
+  void add(const TMemberMap::value_type& entry); // grows the table as needed
+  bool find(const wchar_t* name, size_t len, MemberRef& result) const;
+  static ULONG hashName(const wchar_t* name, size_t len);
+protected:
+  struct Slot
+  {
+    Slot() : hash(0) { ref.name = NULL; ref.member = NULL; ref.kind = mk_Member; }
+    ULONG hash;
+    std::wstring key; // case-folded, including any prefix
+    MemberRef ref;
+  };
+  void reserve(size_t entries);
+  void insert(const std::wstring& key, const std::wstring& name, const MemberInfo& member, int kind);
+  void insertSlot(Slot& slot);
+  std::vector<Slot> slots;
+  ULONG mask;
+  ULONG count;
+};
+
+class OCTypeIndex;
+
+// The member table of one COM type, as collected from its ITypeInfo.
+// Instances are reference counted and shared between every object of the same type.
+// A table is either filled up front by interrogate(), or prepared for lazy binding where
+// single names are resolved through ITypeComp::Bind as they are first used and the full
+// member list is only read by enumerate().  Entries are never removed or moved once added.
+class OCTypeMembers : public OCRefCounted {
+public:
+  typedef OCMemberIndex::TMemberMap TMemberMap;
+  OCTypeMembers();
+  HRESULT interrogate(ITypeInfo* typeInfo);
+  HRESULT prepare(ITypeInfo* typeInfo); // S_FALSE if lazy binding isn't possible and the table was interrogated instead
+  HRESULT enumerate(); // make sure members holds every member of the type
+  void detach(); // forget the ITypeInfo, required before CoUninitialize
+  bool find(const wchar_t* name, size_t len, MemberRef& result);
+  bool empty() const { return !memberCount; }
+public:
+  std::wstring typeName;
+  bool hasDefaultProp;
+  bool shared; // published in the type cache, so the same table is handed to every object of the type
+  TMemberMap members; // may be partial until enumerate() has been called
+  OCMemberIndex index;
+protected:
+  ~OCTypeMembers();
+  HRESULT readMembers(ITypeInfo* typeInfo);
+  HRESULT readMember(MEMBERID memid);
+  bool bind(const wchar_t* name, size_t len);
+  TMemberMap::iterator addFunc(const std::wstring& name, const FUNCDESC* funcdesc, ITypeInfo* typeInfo);
+  TMemberMap::iterator addVar(const std::wstring& name, const VARDESC* vardesc, ITypeInfo* typeInfo);
+  void readSignature(MemberInfo& info, const FUNCDESC* funcdesc, ITypeInfo* typeInfo);
+  ParamInfo* allocParams(size_t count);
+  int memberCount; // cFuncs + cVars while lazy binding, the number of usable members otherwise
+  volatile bool complete; // once set the table is never modified again
+  ITypeInfo2* tinfo; // only held while lazy binding
+  ITypeComp* tcomp;
+  SYSKIND syskind;
+  LCID lcid;
+  std::set<std::wstring, CaseInsensitive> unknown; // names Bind couldn't find, bounded (see find)
+  std::list<std::vector<ParamInfo> > signatures; // what MemberInfo::params points into, never moved once added
+  OCCriticalSection bindLock;
+private:
+  friend class OCTypeIndex; // fills tables from an index file
+  OCTypeMembers(const OCTypeMembers&); // not copyable
+  OCTypeMembers& operator=(const OCTypeMembers&);
+};
+
+// Process-wide cache of member tables, keyed by the type GUID (from TYPEATTR) and LCID
+class OCTypeCache {
+public:
+  struct Stats {
+    ULONG hits;
+    ULONG misses;
+    ULONG entries;
+    ULONG indexed; // misses filled from an index file instead of the ITypeInfo
+  };
+  // returns an AddRef'ed table in *ppType, or NULL if the type has no usable members
+  // lazy tables bind their members through ITypeComp as they are used (see OCTypeMembers::prepare)
+  static HRESULT lookup(ITypeInfo* tinfo, LCID lcid, bool lazy, OCTypeMembers** ppType);
+  static void getStats(Stats& stats);
+  // drops every cached table and the type information they hold, call before CoUninitialize
+  static void clear();
+};
+
+enum ENameCacheMode
+{
+  nc_None = 0,   // always ask the object (IDispatchEx style servers whose names really change)
+  nc_Object = 1, // remember what GetIDsOfNames told us for the lifetime of the object
+  nc_Shared = 2  // share the results between every object of the same CLSID
+};
+
+// Name -> DISPID cache for objects without type information, filled from IDispatch::GetIDsOfNames.
+// Names are compared case-sensitively since dynamic servers may treat "foo" and "Foo" as different members.
+class OCNameCache : public OCRefCounted {
+public:
+  struct Stats {
+    ULONG hits;
+    ULONG misses;
+    ULONG shared;
+  };
+  explicit OCNameCache(bool negative = true);
+  // S_OK with *pid set, DISP_E_UNKNOWNNAME for a remembered failure, or S_FALSE if the name was never seen
+  HRESULT find(const wchar_t* name, size_t len, DISPID* pid);
+  // remembers the result of GetIDsOfNames for this name
+  void insert(const wchar_t* name, size_t len, HRESULT hr, DISPID id);
+  // returns an AddRef'ed cache shared by every object of this class
+  static OCNameCache* getShared(REFCLSID clsid);
+  static void getStats(Stats& stats);
+  // drops the caches shared per CLSID, objects still holding one keep using it
+  static void clearShared();
+protected:
+  ~OCNameCache() {}
+  typedef std::map<std::wstring, DISPID> TNameMap;
+  OCCriticalSection namesLock; // shared instances may be reached from more than one thread
+  TNameMap names;
+  bool negative; // whether failed lookups are remembered
+  size_t negatives; // how many of names are failures, bounded (see insert)
+private:
+  OCNameCache(const OCNameCache&); // not copyable
+  OCNameCache& operator=(const OCNameCache&);
+};
+
+} // namespace ole32core
+
+#endif // __OLETYPEINFO_H__
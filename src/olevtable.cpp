@@ -0,0 +1,240 @@
+/*
+  olevtable.cpp
+  This source is independent of node/v8.
+*/
+
+#include "olevtable.h"
+#include "oletypeinfo.h"
+
+using namespace std;
+
+namespace ole32core {
+
+namespace {
+
+struct GuidLess
+{
+  bool operator()(const GUID& left, const GUID& right) const
+  {
+    return memcmp(&left, &right, sizeof(GUID)) < 0;
+  }
+};
+
+OCSharedCache<GUID, OCVtable, GuidLess> vtableEntries;
+
+// what DispCallFunc can pass (or return through a pointer) without any help from us
+bool isSimpleType(VARTYPE vt)
+{
+  switch (vt)
+  {
+  case VT_I2: case VT_I4: case VT_R4: case VT_R8: case VT_CY: case VT_DATE: case VT_BSTR: case VT_DISPATCH:
+  case VT_ERROR: case VT_BOOL: case VT_VARIANT: case VT_UNKNOWN: case VT_I1: case VT_UI1: case VT_UI2:
+  case VT_UI4: case VT_I8: case VT_UI8: case VT_INT: case VT_UINT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+void readErrorInfo(IUnknown* target, REFIID iid, ErrorInfo& errorInfo)
+{
+  ISupportErrorInfo* support = NULL;
+  if (FAILED(target->QueryInterface(IID_ISupportErrorInfo, (void**)&support)) || !support) return;
+  HRESULT hr = support->InterfaceSupportsErrorInfo(iid);
+  support->Release();
+  IErrorInfo* perr = NULL;
+  if (hr != S_OK || GetErrorInfo(0, &perr) != S_OK || !perr) return;
+  BSTR bText;
+  if (SUCCEEDED(perr->GetDescription(&bText)) && bText)
+  {
+    errorInfo.sDescription = wstring(bText, SysStringLen(bText));
+    SysFreeString(bText);
+  }
+  if (SUCCEEDED(perr->GetSource(&bText)) && bText)
+  {
+    errorInfo.sSource = wstring(bText, SysStringLen(bText));
+    SysFreeString(bText);
+  }
+  if (SUCCEEDED(perr->GetHelpFile(&bText)) && bText)
+  {
+    errorInfo.sHelpFile = wstring(bText, SysStringLen(bText));
+    SysFreeString(bText);
+  }
+  perr->GetHelpContext(&errorInfo.dwHelpContext);
+  perr->Release();
+}
+
+} // namespace
+
+OCVtable::OCVtable() : iid(IID_NULL)
+{
+}
+
+HRESULT OCVtable::lookup(ITypeInfo* tinfo, OCVtable** ppVtable)
+{
+  if (!ppVtable) return E_POINTER;
+  *ppVtable = NULL;
+  if (!tinfo) return S_FALSE;
+
+  TYPEATTR* tattr;
+  HRESULT hr = tinfo->GetTypeAttr(&tattr);
+  if (FAILED(hr)) return hr;
+  GUID guid = tattr->guid;
+  TYPEKIND kind = tattr->typekind;
+  bool bDual = (tattr->wTypeFlags & TYPEFLAG_FDUAL) != 0;
+  tinfo->ReleaseTypeAttr(tattr);
+  if (IsEqualGUID(guid, GUID_NULL)) return S_FALSE;
+
+  if (vtableEntries.find(guid, ppVtable)) return *ppVtable ? S_OK : S_FALSE;
+
+  // a dual dispinterface refers to its vtable interface as implemented type -1
+  OCVtable* vtable = NULL;
+  ITypeInfo* itf = NULL;
+  if (bDual && kind == TKIND_DISPATCH)
+  {
+    HREFTYPE href;
+    if (SUCCEEDED(tinfo->GetRefTypeOfImplType((UINT)-1, &href)) && FAILED(tinfo->GetRefTypeInfo(href, &itf))) itf = NULL;
+  }
+  else if (bDual && kind == TKIND_INTERFACE)
+  {
+    itf = tinfo;
+    itf->AddRef();
+  }
+  if (itf)
+  {
+    if (SUCCEEDED(itf->GetTypeAttr(&tattr)))
+    {
+      vtable = new OCVtable();
+      vtable->iid = tattr->guid;
+      itf->ReleaseTypeAttr(tattr);
+      vtable->addFunctions(itf);
+      if (vtable->entries.empty())
+      {
+        vtable->Release();
+        vtable = NULL;
+      }
+    }
+    itf->Release();
+  }
+
+  vtable = vtableEntries.insert(guid, vtable);
+  *ppVtable = vtable;
+  return vtable ? S_OK : S_FALSE;
+}
+
+void OCVtable::addFunctions(ITypeInfo* itf)
+{
+  TYPEATTR* tattr;
+  if (FAILED(itf->GetTypeAttr(&tattr))) return;
+  bool bDispatch = IsEqualGUID(tattr->guid, IID_IDispatch) || IsEqualGUID(tattr->guid, IID_IUnknown);
+  WORD cFuncs = tattr->cFuncs;
+  WORD cImplTypes = tattr->cImplTypes;
+  itf->ReleaseTypeAttr(tattr);
+  if (bDispatch) return; // nothing to call directly in there
+
+  // members inherited from another dual interface come first in the vtable
+  HREFTYPE href;
+  ITypeInfo* base;
+  if (cImplTypes && SUCCEEDED(itf->GetRefTypeOfImplType(0, &href)) && SUCCEEDED(itf->GetRefTypeInfo(href, &base)))
+  {
+    addFunctions(base);
+    base->Release();
+  }
+
+  for (WORD i = 0; i < cFuncs; ++i)
+  {
+    FUNCDESC* funcdesc;
+    if (FAILED(itf->GetFuncDesc(i, &funcdesc))) continue;
+    Entry entry;
+    entry.oVft = funcdesc->oVft;
+    entry.paramCount = 0;
+    entry.retType = VT_EMPTY;
+    bool bUsable = (funcdesc->funckind == FUNC_PUREVIRTUAL || funcdesc->funckind == FUNC_VIRTUAL)
+      && funcdesc->callconv == CC_STDCALL && funcdesc->elemdescFunc.tdesc.vt == VT_HRESULT
+      && funcdesc->cParamsOpt != -1 && funcdesc->cParams <= MAX_PARAMS + 1;
+    for (SHORT p = 0; bUsable && p < funcdesc->cParams; ++p)
+    {
+      const ELEMDESC& elemdesc = funcdesc->lprgelemdescParam[p];
+      USHORT pflags = elemdesc.paramdesc.wParamFlags;
+      if (pflags & PARAMFLAG_FRETVAL)
+      {
+        // the last one, a pointer to where the result goes
+        VARTYPE vt = resolveVarType(itf, elemdesc.tdesc);
+        bUsable = p == funcdesc->cParams - 1 && elemdesc.tdesc.vt == VT_PTR && (vt & VT_BYREF) && isSimpleType(vt & ~VT_BYREF);
+        entry.retType = vt & ~VT_BYREF;
+        continue;
+      }
+      // interface pointers other than IDispatch* and IUnknown* would need a QueryInterface first
+      VARTYPE vt = resolveVarType(itf, elemdesc.tdesc);
+      bUsable = !(pflags & (PARAMFLAG_FOUT | PARAMFLAG_FLCID)) && elemdesc.tdesc.vt != VT_PTR
+        && !(elemdesc.tdesc.vt == VT_USERDEFINED && (vt == VT_DISPATCH || vt == VT_UNKNOWN))
+        && entry.paramCount < MAX_PARAMS && isSimpleType(vt);
+      if (bUsable) entry.paramTypes[entry.paramCount++] = vt;
+    }
+    if (bUsable)
+    {
+      entries.insert(TEntryMap::value_type(std::make_pair(funcdesc->memid, (WORD)funcdesc->invkind), entry));
+    }
+    itf->ReleaseFuncDesc(funcdesc);
+  }
+}
+
+const OCVtable::Entry* OCVtable::find(DISPID memid, WORD invkind) const
+{
+  static const WORD kinds[] = { DISPATCH_METHOD, DISPATCH_PROPERTYGET, DISPATCH_PROPERTYPUT, DISPATCH_PROPERTYPUTREF };
+  for (int i = 0; i < (int)(sizeof(kinds) / sizeof(kinds[0])); ++i)
+  {
+    if (!(invkind & kinds[i])) continue;
+    TEntryMap::const_iterator found = entries.find(std::make_pair(memid, kinds[i]));
+    if (found != entries.end()) return &found->second;
+  }
+  return NULL;
+}
+
+HRESULT OCVtable::call(IUnknown* target, const Entry& entry, VARIANT* args, VARIANT* pvResult, ErrorInfo& errorInfo) const
+{
+  VARTYPE types[MAX_PARAMS + 1];
+  VARIANTARG* ptrs[MAX_PARAMS + 1];
+  UINT count = 0;
+  for (; count < (UINT)entry.paramCount; ++count)
+  {
+    types[count] = entry.paramTypes[count];
+    ptrs[count] = &args[count];
+  }
+
+  // the result is written straight into the value of a VARIANT, or the VARIANT itself
+  VARIANT result;
+  VariantInit(&result);
+  VARIANTARG retArg;
+  if (entry.retType != VT_EMPTY)
+  {
+    retArg.vt = (VARTYPE)(entry.retType | VT_BYREF);
+    retArg.byref = entry.retType == VT_VARIANT ? (void*)&result : (void*)&result.llVal;
+    types[count] = retArg.vt;
+    ptrs[count++] = &retArg;
+  }
+
+  VARIANT hrResult;
+  VariantInit(&hrResult);
+  HRESULT hr = DispCallFunc(target, entry.oVft, CC_STDCALL, VT_ERROR, count, types, ptrs, &hrResult);
+  if (SUCCEEDED(hr)) hr = hrResult.scode;
+  if (FAILED(hr))
+  {
+    errorInfo.wCode = 0;
+    errorInfo.scode = 0;
+    errorInfo.dwHelpContext = 0;
+    readErrorInfo(target, iid, errorInfo);
+    return hr;
+  }
+  if (entry.retType != VT_EMPTY && entry.retType != VT_VARIANT) result.vt = entry.retType;
+  if (pvResult)
+  {
+    VariantClear(pvResult);
+    *pvResult = result; // ownership moves to the caller
+  } else {
+    VariantClear(&result);
+  }
+  return hr;
+}
+
+} // namespace ole32core
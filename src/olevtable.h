@@ -0,0 +1,43 @@
+#ifndef __OLEVTABLE_H__
+#define __OLEVTABLE_H__
+
+#include <map>
+#include "ole32core.h"
+
+namespace ole32core {
+
+// The vtable layout of a dual interface, so its members can be called through DispCallFunc
+// instead of IDispatch::Invoke. Only members with [in] parameters of simple automation types
+// (and at most a [retval]) are recorded, everything else keeps going through Invoke.
+// Instances are reference counted and shared between every object of the same type.
+class OCVtable : public OCRefCounted {
+public:
+  enum { MAX_PARAMS = 8 };
+  struct Entry
+  {
+    SHORT oVft; // byte offset of the function in the vtable
+    SHORT paramCount; // not counting the retval
+    VARTYPE retType; // VT_EMPTY if nothing is returned
+    VARTYPE paramTypes[MAX_PARAMS];
+  };
+  // returns an AddRef'ed layout of the dual interface behind tinfo, S_FALSE with NULL if it isn't dual
+  static HRESULT lookup(ITypeInfo* tinfo, OCVtable** ppVtable);
+  // invkind is a combination of DISPATCH_ flags, the first one the interface has is returned
+  const Entry* find(DISPID memid, WORD invkind) const;
+  // args are in declaration order and already of the declared types, target must be the interface named by iid
+  HRESULT call(IUnknown* target, const Entry& entry, VARIANT* args, VARIANT* pvResult, ErrorInfo& errorInfo) const;
+  IID iid;
+protected:
+  OCVtable();
+  ~OCVtable() {}
+  void addFunctions(ITypeInfo* itf);
+  typedef std::map<std::pair<DISPID, WORD>, Entry> TEntryMap;
+  TEntryMap entries;
+private:
+  OCVtable(const OCVtable&); // not copyable
+  OCVtable& operator=(const OCVtable&);
+};
+
+} // namespace ole32core
+
+#endif // __OLEVTABLE_H__
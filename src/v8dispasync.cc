@@ -0,0 +1,471 @@
+/*
+  v8dispasync.cc
+*/
+
+#include "v8dispasync.h"
+#include <node.h>
+#include <nan.h>
+#include <vector>
+#include "v8dispatch.h"
+#include "v8variant.h"
+
+using namespace v8;
+using namespace ole32core;
+
+namespace node_win32ole {
+
+Nan::Persistent<FunctionTemplate> V8DispAsync::clazz;
+
+namespace {
+
+typedef std::vector<OCGlobalRef*> TGlobalRefs;
+
+// something done to every interface pointer a VARIANT carries, a failure stops the walk
+class InterfaceVisitor {
+public:
+  virtual HRESULT visit(IUnknown** ppunk, REFIID riid) = 0;
+};
+
+HRESULT VisitInterfaces(VARIANT& v, InterfaceVisitor& visitor);
+
+HRESULT VisitArray(SAFEARRAY* psa, VARTYPE vt, InterfaceVisitor& visitor)
+{
+  if (!psa || (vt != VT_VARIANT && vt != VT_DISPATCH && vt != VT_UNKNOWN)) return S_OK;
+  ULONG count = 1;
+  for (USHORT dim = 0; dim < psa->cDims; ++dim) count *= psa->rgsabound[dim].cElements;
+  void* data;
+  HRESULT hr = SafeArrayAccessData(psa, &data);
+  if (FAILED(hr)) return hr;
+  for (ULONG i = 0; i < count && SUCCEEDED(hr); ++i)
+  {
+    if (vt == VT_VARIANT) hr = VisitInterfaces(((VARIANT*)data)[i], visitor);
+    else hr = visitor.visit(((IUnknown**)data) + i, vt == VT_DISPATCH ? IID_IDispatch : IID_IUnknown);
+  }
+  SafeArrayUnaccessData(psa);
+  return hr;
+}
+
+// v itself, the elements of arrays of VARIANTs or interfaces (nested ones too), and what references point to
+HRESULT VisitInterfaces(VARIANT& v, InterfaceVisitor& visitor)
+{
+  VARTYPE vt = v.vt & VT_TYPEMASK;
+  if (v.vt & VT_ARRAY) return VisitArray((v.vt & VT_BYREF) ? (v.pparray ? *v.pparray : NULL) : v.parray, vt, visitor);
+  if (vt != VT_VARIANT && vt != VT_DISPATCH && vt != VT_UNKNOWN) return S_OK;
+  const IID& riid = vt == VT_DISPATCH ? IID_IDispatch : IID_IUnknown;
+  if (!(v.vt & VT_BYREF)) return vt == VT_VARIANT ? S_OK : visitor.visit(&v.punkVal, riid);
+  if (vt == VT_VARIANT) return v.pvarVal ? VisitInterfaces(*v.pvarVal, visitor) : S_OK;
+  return v.ppunkVal ? visitor.visit(v.ppunkVal, riid) : S_OK;
+}
+
+// moves the interfaces into the global interface table, one entry per slot (NULL for an empty one)
+class ShareVisitor : public InterfaceVisitor {
+public:
+  explicit ShareVisitor(TGlobalRefs& r) : refs(r) {}
+  virtual HRESULT visit(IUnknown** ppunk, REFIID riid)
+  {
+    OCGlobalRef* ref = NULL;
+    if (*ppunk)
+    {
+      HRESULT hr = OCGlobalRef::create(*ppunk, riid, &ref);
+      if (FAILED(hr)) return hr;
+      (*ppunk)->Release();
+      *ppunk = NULL;
+    }
+    refs.push_back(ref);
+    return S_OK;
+  }
+protected:
+  TGlobalRefs& refs;
+};
+
+// the other way round, in the apartment that is going to use the interfaces, the slots are walked in the same order
+class UnshareVisitor : public InterfaceVisitor {
+public:
+  explicit UnshareVisitor(TGlobalRefs& r) : refs(r), next(0) {}
+  virtual HRESULT visit(IUnknown** ppunk, REFIID riid)
+  {
+    if (next >= refs.size()) return E_UNEXPECTED;
+    OCGlobalRef* ref = refs[next++];
+    if (!ref) return S_OK;
+    HRESULT hr = ref->get(riid, (void**)ppunk);
+    if (FAILED(hr)) *ppunk = NULL;
+    return hr;
+  }
+protected:
+  TGlobalRefs& refs;
+  size_t next;
+};
+
+class ReleaseVisitor : public InterfaceVisitor {
+public:
+  virtual HRESULT visit(IUnknown** ppunk, REFIID)
+  {
+    if (*ppunk) (*ppunk)->Release();
+    *ppunk = NULL;
+    return S_OK;
+  }
+};
+
+void ReleaseRefs(TGlobalRefs& refs)
+{
+  for (TGlobalRefs::iterator it = refs.begin(); it != refs.end(); ++it)
+  {
+    if (*it) (*it)->Release();
+  }
+  refs.clear();
+}
+
+// interface pointers can't be used as they are in another apartment, count VARIANTs are left with
+// NULL where they had one and refs with what the other apartment gets them from
+HRESULT ShareInterfaces(int count, VARIANT* vars, TGlobalRefs& refs)
+{
+  ShareVisitor visitor(refs);
+  HRESULT hr = S_OK;
+  for (int i = 0; i < count && SUCCEEDED(hr); ++i) hr = VisitInterfaces(vars[i], visitor);
+  return hr;
+}
+
+// puts the interfaces back into vars for the calling apartment, refs is emptied
+HRESULT UnshareInterfaces(int count, VARIANT* vars, TGlobalRefs& refs)
+{
+  UnshareVisitor visitor(refs);
+  HRESULT hr = S_OK;
+  for (int i = 0; i < count && SUCCEEDED(hr); ++i) hr = VisitInterfaces(vars[i], visitor);
+  ReleaseRefs(refs);
+  return hr;
+}
+
+class V8AsyncCall : public OCTask
+{
+public:
+  V8AsyncCall(OCApartment* a, OCGlobalRef* t, DISPID id, WORD type, int n, VARIANT* v);
+  ~V8AsyncCall(); // main thread
+  virtual void run();
+  virtual void complete();
+  HRESULT prepare(); // main thread, before posting
+  void settle(); // main thread, once completed
+  Nan::Persistent<Promise::Resolver> resolver;
+  Nan::AsyncResource async; // the call as async_hooks and domains see it, settled in its scope
+protected:
+  OCApartment* apartment;
+  OCGlobalRef* target;
+  DISPID propID;
+  WORD targetType;
+  int argc;
+  VARIANT* args;
+  TGlobalRefs argRefs;
+  HRESULT hr;
+  ErrorInfo errInfo;
+  VARIANT result;
+  TGlobalRefs resultRefs;
+};
+
+OCCriticalSection doneLock;
+std::vector<V8AsyncCall*> doneCalls; // completed on their apartments, waiting for the main thread
+uv_async_t doneSignal;
+unsigned outstanding = 0; // main thread only, the event loop is kept alive while calls are out
+OCApartment* asyncWorker = NULL;
+OCApartmentPool staPool(COINIT_APARTMENTTHREADED);
+OCApartmentPool mtaPool(COINIT_MULTITHREADED); // every thread is in the one MTA of the process
+
+V8AsyncCall::V8AsyncCall(OCApartment* a, OCGlobalRef* t, DISPID id, WORD type, int n, VARIANT* v)
+  : async("win32ole.$async"), apartment(a), target(t), propID(id), targetType(type), argc(n), args(v), hr(S_OK)
+{
+  target->AddRef();
+  errInfo.wCode = 0;
+  errInfo.scode = 0;
+  errInfo.dwHelpContext = 0;
+  VariantInit(&result);
+}
+
+V8AsyncCall::~V8AsyncCall()
+{
+  ReleaseRefs(argRefs);
+  for (int i = 0; i < argc; ++i) V8Variant::ClearArgument(args[i]);
+  delete[] args;
+  ReleaseRefs(resultRefs);
+  VariantClear(&result);
+  target->Release();
+  resolver.Reset();
+}
+
+HRESULT V8AsyncCall::prepare()
+{
+  return ShareInterfaces(argc, args, argRefs);
+}
+
+void V8AsyncCall::run()
+{
+  IDispatch* disp = NULL;
+  hr = target->get(IID_IDispatch, (void**)&disp);
+  HRESULT hrArgs = UnshareInterfaces(argc, args, argRefs);
+  if (FAILED(hrArgs) && SUCCEEDED(hr)) hr = hrArgs;
+  if (SUCCEEDED(hr))
+  {
+    OCDispatch ocd(disp);
+    hr = ocd.invoke(targetType, propID, &result, errInfo, argc, args);
+  }
+  if (disp) disp->Release();
+  // the interfaces got here belong to this apartment, the rest of args is cleared by the main thread
+  ReleaseVisitor release;
+  for (int i = 0; i < argc; ++i) VisitInterfaces(args[i], release);
+  if (SUCCEEDED(hr))
+  {
+    HRESULT hrResult = ShareInterfaces(1, &result, resultRefs);
+    if (FAILED(hrResult))
+    {
+      hr = hrResult;
+      VariantClear(&result); // whatever wasn't shared yet
+    }
+  }
+}
+
+void V8AsyncCall::complete()
+{
+  {
+    OCAutoLock lock(doneLock);
+    doneCalls.push_back(this);
+  }
+  uv_async_send(&doneSignal);
+}
+
+void V8AsyncCall::settle()
+{
+  Nan::HandleScope scope;
+  Local<Promise::Resolver> r = Nan::New(resolver);
+  if (SUCCEEDED(hr)) hr = UnshareInterfaces(1, &result, resultRefs);
+  if (FAILED(hr))
+  {
+    r->Reject(NewOleException(hr, errInfo));
+    return;
+  }
+  Nan::TryCatch tryCatch;
+  // objects got from a placed object stay with it, the shared worker only stands in for node's apartment
+  V8Dispatch::ApartmentScope apartmentScope(apartment == asyncWorker ? NULL : apartment);
+  Local<Value> vResult = V8Variant::ResultToValue(result);
+  if (tryCatch.HasCaught()) r->Reject(tryCatch.Exception());
+  else r->Resolve(vResult);
+}
+
+NAN_METHOD(SettleCall)
+{
+  static_cast<V8AsyncCall*>(info.Data().As<External>()->Value())->settle();
+}
+
+NAUV_WORK_CB(OnCallsDone)
+{
+  Nan::HandleScope scope;
+  std::vector<V8AsyncCall*> calls;
+  {
+    OCAutoLock lock(doneLock);
+    calls.swap(doneCalls);
+  }
+  for (std::vector<V8AsyncCall*>::iterator it = calls.begin(); it != calls.end(); ++it)
+  {
+    // like any callback from the event loop, node runs the reactions of the promise when it returns
+    Local<Function> settle = Nan::New<Function>(SettleCall, Nan::New<External>(*it));
+    (*it)->async.runInAsyncScope(Nan::GetCurrentContext()->Global(), settle, 0, NULL);
+    delete *it;
+  }
+  outstanding -= (unsigned)calls.size();
+  if (!outstanding) uv_unref((uv_handle_t*)&doneSignal);
+}
+
+// what promises, string conversions and console.log look for on any object, none of them calls the server
+bool IsReservedName(Local<String> property)
+{
+  if (property->StrictEquals(Nan::New("then").ToLocalChecked())) return true; // we'd look like a thenable to await
+  if (property->StrictEquals(Nan::New("inspect").ToLocalChecked())) return true;
+  return Nan::Has(Nan::New<Object>(), property).FromMaybe(false); // on Object.prototype
+}
+
+void StopAsyncWorker(void*)
+{
+  if (asyncWorker)
+  {
+    asyncWorker->stop();
+    delete asyncWorker;
+    asyncWorker = NULL;
+  }
+  staPool.stop();
+  mtaPool.stop();
+}
+
+} // namespace
+
+OCApartment* AsyncWorker()
+{
+  if (!asyncWorker)
+  {
+    asyncWorker = new OCApartment(COINIT_APARTMENTTHREADED);
+    if (FAILED(asyncWorker->start()))
+    {
+      delete asyncWorker;
+      asyncWorker = NULL;
+    }
+  }
+  return asyncWorker;
+}
+
+HRESULT PoolApartment(DWORD coinit, OCApartment** ppApartment)
+{
+  *ppApartment = NULL;
+  OCApartmentPool& pool = coinit == COINIT_MULTITHREADED ? mtaPool : staPool;
+  if (!pool.size())
+  {
+    HRESULT hr = pool.start(module_options.apartmentThreads);
+    if (FAILED(hr)) return hr;
+  }
+  *ppApartment = pool.pick();
+  return S_OK;
+}
+
+OCApartment* CallingApartment(OCApartment* home)
+{
+  // any thread of the MTA can call the object directly, the idlest one does
+  if (home->coinit() != COINIT_MULTITHREADED) return home;
+  OCApartment* idlest = mtaPool.idlest();
+  return idlest ? idlest : home;
+}
+
+Local<Value> StartAsyncCall(OCApartment* apartment, OCGlobalRef* target, DISPID propID, WORD targetType, int argc, VARIANT* args)
+{
+  V8AsyncCall* call = new V8AsyncCall(apartment, target, propID, targetType, argc, args);
+  HRESULT hr = call->prepare();
+  if (SUCCEEDED(hr))
+  {
+    Local<Promise::Resolver> r;
+    if (!Promise::Resolver::New(Nan::GetCurrentContext()).ToLocal(&r))
+    {
+      delete call; // the exception is pending
+      return Nan::Undefined();
+    }
+    call->resolver.Reset(r);
+    if (!outstanding++) uv_ref((uv_handle_t*)&doneSignal);
+    if (apartment->post(call)) return Nan::New(call->resolver)->GetPromise();
+    if (!--outstanding) uv_unref((uv_handle_t*)&doneSignal);
+    hr = RPC_E_DISCONNECTED; // the thread is gone
+  }
+  delete call;
+  Nan::ThrowError(NewOleException(hr));
+  return Nan::Undefined();
+}
+
+Local<Value> SettledCall(HRESULT hr, const ErrorInfo& errInfo, VARIANT& result, int argc, VARIANT* args)
+{
+  for (int i = 0; i < argc; ++i) V8Variant::ClearArgument(args[i]);
+  delete[] args;
+  Local<Promise::Resolver> r;
+  if (!Promise::Resolver::New(Nan::GetCurrentContext()).ToLocal(&r))
+  {
+    VariantClear(&result);
+    return Nan::Undefined(); // the exception is pending
+  }
+  if (FAILED(hr))
+  {
+    r->Reject(NewOleException(hr, errInfo));
+  } else {
+    Nan::TryCatch tryCatch;
+    Local<Value> vResult = V8Variant::ResultToValue(result);
+    if (tryCatch.HasCaught()) r->Reject(tryCatch.Exception());
+    else r->Resolve(vResult);
+  }
+  VariantClear(&result);
+  return r->GetPromise();
+}
+
+void V8DispAsync::Init(Nan::ADDON_REGISTER_FUNCTION_ARGS_TYPE target)
+{
+  Nan::HandleScope scope;
+  Local<FunctionTemplate> t = Nan::New<FunctionTemplate>(New);
+  t->InstanceTemplate()->SetInternalFieldCount(3); // ourselves, the V8Dispatch, and the functions handed out so far
+  t->SetClassName(Nan::New("V8DispAsync").ToLocalChecked());
+  Local<ObjectTemplate> instancetpl = t->InstanceTemplate();
+  Nan::SetNamedPropertyHandler(instancetpl, OLEGetAttr);
+  Nan::Set(target, Nan::New("V8DispAsync").ToLocalChecked(), t->GetFunction());
+  clazz.Reset(t);
+
+  uv_async_init(uv_default_loop(), &doneSignal, OnCallsDone);
+  uv_unref((uv_handle_t*)&doneSignal);
+  node::AtExit(StopAsyncWorker);
+}
+
+MaybeLocal<Object> V8DispAsync::CreateNew(Handle<Object> dispatch)
+{
+  DISPFUNCIN();
+  Local<FunctionTemplate> localClazz = Nan::New(clazz);
+  Local<v8::Value> args[] = { dispatch };
+  int argc = sizeof(args) / sizeof(args[0]); // == 1
+  return Nan::NewInstance(Nan::GetFunction(localClazz).ToLocalChecked(), argc, args);
+  DISPFUNCOUT();
+}
+
+NAN_METHOD(V8DispAsync::New)
+{
+  DISPFUNCIN();
+  if(!info.IsConstructCall())
+    return Nan::ThrowTypeError("Use the new operator to create new V8DispAsync objects");
+  Local<FunctionTemplate> v8DispatchClazz = Nan::New(V8Dispatch::clazz);
+  if (info.Length() != 1 || !info[0]->IsObject() || !v8DispatchClazz->HasInstance(info[0]))
+    return Nan::ThrowTypeError("Must be constructed with (V8Dispatch)");
+  V8DispAsync *v = new V8DispAsync(); // must catch exception
+  CHECK_V8(V8DispAsync, v);
+  Local<Object> thisObject = info.This();
+  v->Wrap(thisObject); // InternalField[0]
+  thisObject->SetInternalField(1, info[0]);
+  thisObject->SetInternalField(2, Nan::New<Object>());
+  v->owner = V8Dispatch::Unwrap<V8Dispatch>(Local<Object>::Cast(info[0]));
+  DISPFUNCOUT();
+  return info.GetReturnValue().Set(thisObject);
+}
+
+NAN_PROPERTY_GETTER(V8DispAsync::OLEGetAttr)
+{
+  OLETRACEIN();
+  if (IsReservedName(property)) return;
+  Local<Object> thisObject = info.This();
+  Local<Object> functions = thisObject->GetInternalField(2).As<Object>();
+  Local<Value> vFunction;
+  if (Nan::HasOwnProperty(functions, property).FromJust())
+  {
+    vFunction = Nan::Get(functions, property).ToLocalChecked();
+  } else {
+    // the name is resolved when called, each function knows which member it stands for
+    Local<Array> data = Nan::New<Array>(2);
+    Nan::Set(data, 0, thisObject);
+    Nan::Set(data, 1, property);
+    vFunction = Nan::New<Function>(OLEAsyncCall, data);
+    Nan::Set(functions, property, vFunction);
+  }
+  OLETRACEOUT();
+  return info.GetReturnValue().Set(vFunction);
+}
+
+NAN_METHOD(V8DispAsync::OLEAsyncCall)
+{
+  OLETRACEIN();
+  OLETRACEARGS();
+  Local<Array> data = info.Data().As<Array>();
+  Local<Object> asyncObject = Nan::Get(data, 0).ToLocalChecked().As<Object>();
+  Local<String> name = Nan::Get(data, 1).ToLocalChecked().As<String>();
+  V8DispAsync *vThis = V8DispAsync::Unwrap<V8DispAsync>(asyncObject);
+  CHECK_V8(V8DispAsync, vThis);
+  V8Dispatch* vDisp = vThis->getDispatch();
+  CHECK_V8(V8Dispatch, vDisp);
+
+  int argc = info.Length();
+  Local<Value>* argv = (Local<Value>*)alloca(sizeof(Local<Value>) * (argc ? argc : 1));
+  for (int idx = 0; idx < argc; ++idx)
+  {
+    *(new(argv + idx) Local<Value>) = info[idx];
+  }
+  Local<Value> vResult = vDisp->OLECallAsync(name, argc, argv);
+  for (int idx = 0; idx < argc; ++idx)
+  {
+    (argv + idx)->~Local<Value>();
+  }
+  if (!vResult->IsUndefined()) info.GetReturnValue().Set(vResult);
+  OLETRACEOUT();
+}
+
+} // namespace node_win32ole
@@ -0,0 +1,47 @@
+#ifndef __V8DISPASYNC_H__
+#define __V8DISPASYNC_H__
+
+#include <node.h>
+#include <nan.h>
+#include "node_win32ole.h"
+#include "ole32core.h"
+#include "oleapartment.h"
+
+namespace node_win32ole {
+
+class V8Dispatch;
+
+// obj.$async: every member read from it is a function running that member on another thread
+// and returning a Promise of its result
+class V8DispAsync : public node::ObjectWrap {
+public:
+  static Nan::Persistent<FunctionTemplate> clazz;
+  static void Init(Nan::ADDON_REGISTER_FUNCTION_ARGS_TYPE target);
+  static MaybeLocal<Object> CreateNew(Handle<Object> dispatch); // *** private
+  static NAN_METHOD(New);
+  static NAN_PROPERTY_GETTER(OLEGetAttr);
+  static NAN_METHOD(OLEAsyncCall);
+public:
+  inline V8DispAsync() : owner(NULL) {}
+protected:
+  V8Dispatch* getDispatch() const { return owner; }
+  V8Dispatch* owner; // kept alive by InternalField[1]
+};
+
+// the thread $async calls of objects living in the main apartment go to
+ole32core::OCApartment* AsyncWorker();
+// the least busy thread of the pool objects created with {apartment: 'pool'} (COINIT_APARTMENTTHREADED)
+// or {apartment: 'mta'} (COINIT_MULTITHREADED) go to, started on first use
+HRESULT PoolApartment(DWORD coinit, ole32core::OCApartment** ppApartment);
+// where $async calls to an object placed in home run
+ole32core::OCApartment* CallingApartment(ole32core::OCApartment* home);
+// posts the call to apartment, taking over args (in DISPPARAMS order, already marshaled). The returned
+// Promise settles on the main thread, objects in the result are handed to the caller's apartment
+Local<Value> StartAsyncCall(ole32core::OCApartment* apartment, ole32core::OCGlobalRef* target,
+  DISPID propID, WORD targetType, int argc, VARIANT* args);
+// a Promise already settled with the outcome of a call made on the main thread, takes over args and result
+Local<Value> SettledCall(HRESULT hr, const ole32core::ErrorInfo& errInfo, VARIANT& result, int argc, VARIANT* args);
+
+} // namespace node_win32ole
+
+#endif // __V8DISPASYNC_H__
@@ -5,7 +5,11 @@
 #include "v8dispatch.h"
 #include <node.h>
 #include <nan.h>
+#include <dispex.h>
+#include <map>
 #include <set>
+#include <vector>
+#include "v8dispasync.h"
 #include "v8dispidxprop.h"
 #include "v8dispmember.h"
 #include "v8dispmethod.h"
@@ -17,12 +21,113 @@ using namespace ole32core;
 namespace node_win32ole {
 
 Nan::Persistent<FunctionTemplate> V8Dispatch::clazz;
+OCApartment* V8Dispatch::ApartmentScope::current = NULL;
+
+namespace {
+
+// A small direct-mapped cache of recent name resolutions, keyed by the name handle V8 passes
+// to the interceptors (usually internalized) so hot property names skip the copy and the hash.
+// Each entry holds a reference on its type so a recycled OCTypeMembers address can't alias it.
+struct NameCacheEntry
+{
+  OCTypeMembers* type;
+  Nan::Persistent<String> name;
+  MemberRef ref;
+};
+
+const unsigned NAME_CACHE_SIZE = 256; // must be a power of two
+NameCacheEntry nameCache[NAME_CACHE_SIZE];
+
+// the classes built for typed objects, each holds a reference on its (shared) member table
+typedef std::map<OCTypeMembers*, Nan::Persistent<FunctionTemplate>*> TTypedClassMap;
+TTypedClassMap typedClasses;
+
+// stands in for the default property of typed classes whose table doesn't name it
+struct UnnamedDefaultMember : public MemberInfo
+{
+  UnnamedDefaultMember() { memberID = DISPID_VALUE; }
+} unnamedDefaultMember;
+
+inline const MemberInfo* TypedMember(Local<Value> data)
+{
+  return (const MemberInfo*)data.As<External>()->Value();
+}
+
+// converts an argument to the type the member declares, so the server doesn't have to
+HRESULT CoerceArgument(VARIANT& v, VARTYPE vt)
+{
+  if (v.vt & VT_ARRAY) return S_OK; // arrays are left to the server, they may be pinned JS memory
+  switch (vt)
+  {
+  case VT_I2: case VT_I4: case VT_R4: case VT_R8: case VT_CY: case VT_DATE: case VT_BSTR: case VT_BOOL:
+  case VT_DECIMAL: case VT_I1: case VT_UI1: case VT_UI2: case VT_UI4: case VT_I8: case VT_UI8: case VT_INT: case VT_UINT:
+    if (v.vt == vt || v.vt == VT_EMPTY || v.vt == VT_NULL || v.vt == VT_ERROR || v.vt == VT_DISPATCH) return S_OK;
+    return VariantChangeType(&v, &v, 0, vt);
+  default:
+    return S_OK; // VARIANTs, interfaces, arrays and references are passed as they are
+  }
+}
+
+// what objects aggregating the free-threaded marshaler answer to IMarshal::GetUnmarshalClass
+const CLSID CLSID_FreeThreadedMarshaler = { 0x0000033a, 0x0000, 0x0000, { 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 } };
+
+bool IsDefaultPropertyName(Local<String> property)
+{
+  if (property->Length() != 1) return false;
+  String::Value vProperty(property);
+  return (*vProperty)[0] == L'_';
+}
+
+} // namespace
+
+// converts the arguments into args in DISPPARAMS (reverse) order, args must have room for argc of them.
+// Throws and returns false if one can't be, otherwise the caller clears them with ClearArguments.
+// bPin passes TypedArrays and Buffers without copying and lends strings from the string cache,
+// only for calls completed before argv goes away
+bool MarshalArguments(int argc, Local<Value> argv[], const VARTYPE* argTypes, VARIANT* args, bool bPin)
+{
+  for (int i = 0; i < argc; ++i) {
+    VARIANT& arg = args[argc - i - 1];
+    VariantInit(&arg);
+    bool bOk = true;
+    if (argTypes && argTypes[i] != VT_EMPTY && argv[i]->IsUndefined())
+    {
+      arg.vt = VT_ERROR; // an omitted optional argument
+      arg.scode = DISP_E_PARAMNOTFOUND;
+    } else {
+      // strings declared as passed by value can't be changed by the callee, so they may be shared
+      bool bLend = bPin && argTypes && (argTypes[i] == VT_BSTR || argTypes[i] == VT_VARIANT);
+      bOk = V8Variant::ValueToVariant(argv[i], arg, bLend, bPin);
+      if (bOk && argTypes)
+      {
+        HRESULT hr = CoerceArgument(arg, argTypes[i]);
+        if (FAILED(hr))
+        {
+          bOk = false;
+          Nan::ThrowError(NewOleException(hr));
+        }
+      }
+    }
+    if (!bOk)
+    {
+      V8Variant::ClearArgument(arg);
+      while (i--) V8Variant::ClearArgument(args[argc - i - 1]);
+      return false;
+    }
+  }
+  return true;
+}
+
+void ClearArguments(int argc, VARIANT* args)
+{
+  for (int i = 0; i < argc; ++i) V8Variant::ClearArgument(args[i]);
+}
 
 void V8Dispatch::Init(Nan::ADDON_REGISTER_FUNCTION_ARGS_TYPE target)
 {
   Nan::HandleScope scope;
   Local<FunctionTemplate> t = Nan::New<FunctionTemplate>(New);
-  t->InstanceTemplate()->SetInternalFieldCount(1);
+  t->InstanceTemplate()->SetInternalFieldCount(2); // the object, and the member wrappers handed out
   t->SetClassName(Nan::New("V8Dispatch").ToLocalChecked());
   Nan::SetPrototypeMethod(t, "valueOf", OLEPrimitiveValue);
   Nan::SetPrototypeMethod(t, "toString", OLEStringValue);
@@ -40,10 +145,20 @@ void V8Dispatch::Init(Nan::ADDON_REGISTER_FUNCTION_ARGS_TYPE target)
   Nan::SetNamedPropertyHandler(instancetpl, OLEGetAttr, OLESetAttr, OLEQueryAttr, NULL, OLEEnumAttr);
   Nan::SetIndexedPropertyHandler(instancetpl, OLEGetIdxAttr, OLESetIdxAttr);
   Nan::SetPrototypeMethod(t, "Finalize", Finalize);
+  Nan::SetAccessor(t->PrototypeTemplate(), Nan::New("$async").ToLocalChecked(), OLEAsyncGet);
+  Nan::SetPrototypeMethod(t, "$dispid", OLEDispID);
+  Nan::SetPrototypeMethod(t, "$invoke", OLEInvoke);
   Nan::Set(target, Nan::New("V8Dispatch").ToLocalChecked(), t->GetFunction());
   clazz.Reset(t);
 }
 
+V8Dispatch::V8Dispatch() : finalized(false), m_bInterrogated(false), m_type(NULL),
+  m_names(NULL), m_nameCacheMode(module_options.nameCache), m_bHasClsid(false),
+  m_bVtblChecked(false), m_vtbl(NULL), m_vtblTarget(NULL), m_agility(-1), m_shared(NULL),
+  m_apartment(NULL)
+{
+}
+
 NAN_METHOD(V8Dispatch::OLEValue)
 {
   OLETRACEIN();
@@ -53,7 +168,7 @@ NAN_METHOD(V8Dispatch::OLEValue)
   HRESULT hr = vThis->interrogateType();
   if (FAILED(hr)) return Nan::ThrowError(NewOleException(hr));
 
-  if (vThis->m_members.empty() || vThis->m_bHasDefaultProp)
+  if (!vThis->m_type || vThis->m_type->hasDefaultProp)
   {
     // we either have no type information or we know there is a default property here, fetch it
     Local<Value> vResult = vThis->OLEGet(DISPID_VALUE);
@@ -63,7 +178,7 @@ NAN_METHOD(V8Dispatch::OLEValue)
 
   // we have no special action, return our object type name
   OLETRACEOUT();
-  return info.GetReturnValue().Set(Nan::New((const uint16_t*)vThis->m_typeName.c_str()).ToLocalChecked());
+  return info.GetReturnValue().Set(Nan::New((const uint16_t*)vThis->typeName().c_str()).ToLocalChecked());
 }
 
 Local<Value> V8Dispatch::resolveValueChain(Local<Object> thisObject, const char* prop)
@@ -79,7 +194,7 @@ Local<Value> V8Dispatch::resolveValueChain(Local<Object> thisObject, const char*
     return Nan::Undefined();
   }
 
-  if (vThis->m_members.empty() || vThis->m_bHasDefaultProp)
+  if (!vThis->m_type || vThis->m_type->hasDefaultProp)
   {
     // we either have no type information or we know there is a default property here, fetch it
     Local<Value> vResult = vThis->OLEGet(DISPID_VALUE);
@@ -90,7 +205,7 @@ Local<Value> V8Dispatch::resolveValueChain(Local<Object> thisObject, const char*
 
   // we have no special action, return our object type name
   OLETRACEOUT();
-  return Nan::New((const uint16_t*)vThis->m_typeName.c_str()).ToLocalChecked();
+  return Nan::New((const uint16_t*)vThis->typeName().c_str()).ToLocalChecked();
 }
 
 /**
@@ -127,20 +242,113 @@ NAN_METHOD(V8Dispatch::OLELocaleStringValue)
 MaybeLocal<Object> V8Dispatch::CreateNew(IDispatch* disp)
 {
   DISPFUNCIN();
+  OCDispatch ocd(disp);
+  OCTypeMembers* type = NULL;
   Local<FunctionTemplate> localClazz = Nan::New(clazz);
+  if (disp && module_options.typedTemplates)
+  {
+    // anything going wrong here just leaves the object to the interceptors
+    if (SUCCEEDED(OCTypeCache::lookup(ocd.getTypeInfo(), LOCALE_USER_DEFAULT, module_options.lazyBinding, &type))
+      && type && type->shared && SUCCEEDED(type->enumerate()))
+    {
+      localClazz = typedClass(type);
+    }
+  }
   MaybeLocal<Object> mInstance = Nan::NewInstance(Nan::GetFunction(localClazz).ToLocalChecked(), 0, NULL);
-  if (mInstance.IsEmpty()) return mInstance;
+  if (mInstance.IsEmpty())
+  {
+    if (type) type->Release();
+    return mInstance;
+  }
   Local<Object> instance = mInstance.ToLocalChecked();
   if (disp)
   {
     V8Dispatch *vThis = V8Dispatch::Unwrap<V8Dispatch>(instance);
-    vThis->ocd.disp = disp;
-    vThis->ocd.disp->AddRef();
+    vThis->ocd = ocd;
+    if (type)
+    {
+      vThis->m_type = type; // takes our reference
+      vThis->m_bInterrogated = true;
+    }
+    if (ApartmentScope::current) vThis->setApartment(ApartmentScope::current);
   }
   DISPFUNCOUT();
   return instance;
 }
 
+Local<FunctionTemplate> V8Dispatch::typedClass(OCTypeMembers* type)
+{
+  TTypedClassMap::const_iterator found = typedClasses.find(type);
+  if (found != typedClasses.end()) return Nan::New(*found->second);
+
+  // properties become accessors on the instance and methods live on the prototype, so every object
+  // of this type shares one hidden class; the rest (valueOf, Finalize, ...) is inherited from V8Dispatch
+  Local<FunctionTemplate> t = Nan::New<FunctionTemplate>(New);
+  t->Inherit(Nan::New(clazz));
+  t->SetClassName(Nan::New((const uint16_t*)type->typeName.c_str()).ToLocalChecked());
+  Local<ObjectTemplate> instancetpl = t->InstanceTemplate();
+  instancetpl->SetInternalFieldCount(2);
+  Nan::SetIndexedPropertyHandler(instancetpl, OLEGetIdxAttr, OLESetIdxAttr);
+  Local<ObjectTemplate> prototpl = t->PrototypeTemplate();
+  Local<Signature> sig = Nan::New<Signature>(t);
+
+  const MemberInfo* defaultMember = &unnamedDefaultMember;
+  for (OCTypeMembers::TMemberMap::const_iterator trans = type->members.begin(); trans != type->members.end(); trans++)
+  {
+    // the accessors and methods carry the declaration, the table outlives them
+    const MemberInfo& minfo = trans->second;
+    Local<String> vName = Nan::New((const uint16_t*)trans->first.c_str()).ToLocalChecked();
+    Local<External> vMember = Nan::New<External>(const_cast<MemberInfo*>(&minfo));
+    int attrs = minfo.attrs & ma_IsHidden ? DontEnum : None;
+    if (minfo.memberID == DISPID_VALUE) defaultMember = &minfo;
+    if (minfo.attrs & ma_IsProperty)
+    {
+      if (minfo.attrs & ma_IsIndexedProperty)
+      {
+        Nan::SetAccessor(instancetpl, vName, OLETypedIdxGet, OLETypedIdxSet, vMember, DEFAULT, (PropertyAttribute)(DontDelete | attrs));
+      } else {
+        Nan::SetAccessor(instancetpl, vName, OLETypedGet, OLETypedSet, vMember, DEFAULT, (PropertyAttribute)(DontDelete | attrs));
+      }
+      // the same get_ and put_ names the interceptor resolves
+      Nan::SetTemplate(prototpl, Nan::New((const uint16_t*)(L"get_" + trans->first).c_str()).ToLocalChecked(),
+        Nan::New<FunctionTemplate>(OLETypedPropGet, vMember, sig), DontEnum);
+      Nan::SetTemplate(prototpl, Nan::New((const uint16_t*)(L"put_" + trans->first).c_str()).ToLocalChecked(),
+        Nan::New<FunctionTemplate>(OLETypedPropPut, vMember, sig), DontEnum);
+    } else {
+      Nan::SetTemplate(prototpl, vName, Nan::New<FunctionTemplate>(OLETypedCall, vMember, sig), (PropertyAttribute)attrs);
+    }
+  }
+  if (type->hasDefaultProp)
+  {
+    Nan::SetAccessor(instancetpl, Nan::New("_").ToLocalChecked(), OLETypedGet, OLETypedSet,
+      Nan::New<External>(const_cast<MemberInfo*>(defaultMember)), DEFAULT, (PropertyAttribute)(DontDelete | DontEnum));
+  }
+
+  type->AddRef();
+  typedClasses[type] = new Nan::Persistent<FunctionTemplate>(t);
+  return t;
+}
+
+void V8Dispatch::ClearTypeCaches()
+{
+  // objects made from these classes hold their own reference on the table, so it outlives them
+  for (TTypedClassMap::iterator it = typedClasses.begin(); it != typedClasses.end(); ++it)
+  {
+    it->second->Reset();
+    delete it->second;
+    it->first->Release();
+  }
+  typedClasses.clear();
+  for (unsigned slot = 0; slot < NAME_CACHE_SIZE; ++slot)
+  {
+    NameCacheEntry& entry = nameCache[slot];
+    if (!entry.type) continue;
+    entry.type->Release();
+    entry.type = NULL;
+    entry.name.Reset();
+  }
+}
+
 NAN_METHOD(V8Dispatch::New)
 {
   DISPFUNCIN();
@@ -154,7 +362,7 @@ NAN_METHOD(V8Dispatch::New)
   return info.GetReturnValue().Set(thisObject);
 }
 
-Local<Value> V8Dispatch::OLECall(DISPID propID, Nan::NAN_METHOD_ARGS_TYPE info, WORD targetType /* = DISPATCH_METHOD | DISPATCH_PROPERTYGET */)
+Local<Value> V8Dispatch::OLECall(DISPID propID, Nan::NAN_METHOD_ARGS_TYPE info, WORD targetType /* = DISPATCH_METHOD | DISPATCH_PROPERTYGET */, const MemberInfo* member /* = NULL */)
 {
   DISPFUNCIN();
   int argc = info.Length();
@@ -163,7 +371,16 @@ Local<Value> V8Dispatch::OLECall(DISPID propID, Nan::NAN_METHOD_ARGS_TYPE info,
   {
     *(new(argv + idx) Local<Value>) = info[idx];
   }
-  Local<Value> hResult = OLECall(propID, argc, argv, targetType);
+  VARTYPE* argTypes = (VARTYPE*)alloca(sizeof(VARTYPE) * (argc + 1));
+  Local<Value> hResult;
+  HRESULT hr = declaredTypes(member, targetType, argc, argv, argTypes);
+  if (FAILED(hr))
+  {
+    Nan::ThrowError(NewOleException(hr));
+    hResult = Nan::Undefined();
+  } else {
+    hResult = OLECall(propID, argc, argv, targetType, hr == S_OK ? argTypes : NULL);
+  }
   for (int idx = 0; idx < argc; ++idx)
   {
     (argv + idx)->~Local<Value>();
@@ -172,61 +389,96 @@ Local<Value> V8Dispatch::OLECall(DISPID propID, Nan::NAN_METHOD_ARGS_TYPE info,
   return hResult;
 }
 
-Local<Value> V8Dispatch::OLECall(DISPID propID, int argc, Local<Value> argv[], WORD targetType /* = DISPATCH_METHOD | DISPATCH_PROPERTYGET */ )
+HRESULT V8Dispatch::declaredTypes(const MemberInfo* member, WORD targetType, int argc, Local<Value> argv[], VARTYPE* argTypes)
 {
-  OLETRACEIN();
-  OCVariant **argchain = argc ? (OCVariant**)alloca(sizeof(OCVariant*) * argc) : NULL;
-  for (int i = 0; i < argc; ++i) {
-    OCVariant *o = V8Variant::ValueToVariant(argv[i]);
-    if (!o) return Nan::Undefined();
-    argchain[i] = o;
+  // members point into m_type, which is gone once we're finalized
+  if (!member || !m_type || member->paramCount < 0) return S_FALSE;
+
+  // a put passes the indexes of the property get followed by the value
+  bool bPut = (targetType & (DISPATCH_PROPERTYPUT | DISPATCH_PROPERTYPUTREF)) != 0;
+  int nArgs = bPut ? argc - 1 : argc;
+  if (bPut && !(member->attrs & ma_IsProperty)) return S_FALSE;
+  if (nArgs < member->requiredCount || (nArgs > member->paramCount && !(member->attrs & ma_VarArg)))
+  {
+    return DISP_E_BADPARAMCOUNT;
   }
+  for (int i = 0; i < nArgs; ++i)
+  {
+    if (i >= member->paramCount)
+    {
+      argTypes[i] = VT_VARIANT; // passed through to the vararg array
+      continue;
+    }
+    const ParamInfo& param = member->params[i];
+    bool bOptional = (param.flags & (pf_Optional | pf_HasDefault)) != 0;
+    argTypes[i] = argv[i]->IsUndefined() && !bOptional ? VT_EMPTY : param.vt;
+  }
+  if (bPut) argTypes[nArgs] = argv[nArgs]->IsUndefined() ? VT_EMPTY : member->vt;
+  return S_OK;
+}
+
+Local<Value> V8Dispatch::OLECall(DISPID propID, int argc, Local<Value> argv[], WORD targetType /* = DISPATCH_METHOD | DISPATCH_PROPERTYGET */, const VARTYPE* argTypes /* = NULL */)
+{
+  OLETRACEIN();
+  VARIANT* args = argc ? (VARIANT*)alloca(sizeof(VARIANT) * argc) : NULL;
+  if (!MarshalArguments(argc, argv, argTypes, args, true)) return Nan::Undefined();
   ErrorInfo errInfo;
   OCVariant rv;
-  HRESULT hr = ocd.invoke(targetType, propID, &rv.v, errInfo, argc, argchain); // argchain will be deleted automatically
+  HRESULT hr = invoke(targetType, propID, &rv.v, errInfo, argc, args);
+  ClearArguments(argc, args);
   if (FAILED(hr))
   {
     Nan::ThrowError(NewOleException(hr, errInfo));
     return Nan::Undefined();
   }
-  Local<Value> vResult = V8Variant::VariantToValue(rv.v);
+  ApartmentScope scope(m_apartment);
+  Local<Value> vResult = V8Variant::ResultToValue(rv.v);
   OLETRACEOUT();
   return vResult;
 }
 
-Local<Value> V8Dispatch::OLEGet(DISPID propID, int argc, Local<Value> argv[])
+Local<Value> V8Dispatch::OLEGet(DISPID propID, int argc, Local<Value> argv[], const MemberInfo* member)
 {
   OLETRACEIN();
-  OCVariant **argchain = argc ? (OCVariant**)alloca(sizeof(OCVariant*) * argc) : NULL;
-  for (int i = 0; i < argc; ++i) {
-    OCVariant *o = V8Variant::ValueToVariant(argv[i]);
-    if (!o) return Nan::Undefined();
-    argchain[i] = o;
+  VARTYPE* argTypes = argc ? (VARTYPE*)alloca(sizeof(VARTYPE) * argc) : NULL;
+  HRESULT hr = declaredTypes(member, DISPATCH_PROPERTYGET, argc, argv, argTypes);
+  if (FAILED(hr))
+  {
+    Nan::ThrowError(NewOleException(hr));
+    return Nan::Undefined();
   }
+  VARIANT* args = argc ? (VARIANT*)alloca(sizeof(VARIANT) * argc) : NULL;
+  if (!MarshalArguments(argc, argv, hr == S_OK ? argTypes : NULL, args, true)) return Nan::Undefined();
   ErrorInfo errInfo;
   OCVariant rv;
-  HRESULT hr = ocd.invoke(DISPATCH_PROPERTYGET, propID, &rv.v, errInfo, argc, argchain); // argchain will be deleted automatically
+  hr = invoke(DISPATCH_PROPERTYGET, propID, &rv.v, errInfo, argc, args);
+  ClearArguments(argc, args);
   if (FAILED(hr))
   {
     Nan::ThrowError(NewOleException(hr, errInfo));
     return Nan::Undefined();
   }
-  Local<Value> vResult = V8Variant::VariantToValue(rv.v);
+  ApartmentScope scope(m_apartment);
+  Local<Value> vResult = V8Variant::ResultToValue(rv.v);
   OLETRACEOUT();
   return vResult;
 }
 
-bool V8Dispatch::OLESet(DISPID propID, int argc, Local<Value> argv[])
+bool V8Dispatch::OLESet(DISPID propID, int argc, Local<Value> argv[], const MemberInfo* member)
 {
   OLETRACEIN();
-  OCVariant **argchain = argc ? (OCVariant**)alloca(sizeof(OCVariant*) * argc) : NULL;
-  for (int i = 0; i < argc; ++i) {
-    OCVariant *o = V8Variant::ValueToVariant(argv[i]);
-    if (!o) return false;
-    argchain[i] = o;
+  VARTYPE* argTypes = argc ? (VARTYPE*)alloca(sizeof(VARTYPE) * argc) : NULL;
+  HRESULT hr = declaredTypes(member, DISPATCH_PROPERTYPUT, argc, argv, argTypes);
+  if (FAILED(hr))
+  {
+    Nan::ThrowError(NewOleException(hr));
+    return false;
   }
+  VARIANT* args = argc ? (VARIANT*)alloca(sizeof(VARIANT) * argc) : NULL;
+  if (!MarshalArguments(argc, argv, hr == S_OK ? argTypes : NULL, args, true)) return false;
   ErrorInfo errInfo;
-  HRESULT hr = ocd.invoke(DISPATCH_PROPERTYPUT, propID, NULL, errInfo, argc, argchain); // argchain will be deleted automatically
+  hr = invoke(DISPATCH_PROPERTYPUT, propID, NULL, errInfo, argc, args);
+  ClearArguments(argc, args);
   if (FAILED(hr))
   {
     Nan::ThrowError(NewOleException(hr, errInfo));
@@ -236,97 +488,482 @@ bool V8Dispatch::OLESet(DISPID propID, int argc, Local<Value> argv[])
   return true;
 }
 
-HRESULT V8Dispatch::interrogateType()
+Local<Array> V8Dispatch::OLEBatch(Local<Array> ops)
 {
-  if (!m_members.empty() || !ocd.disp) return S_FALSE;
-  ITypeInfo* tinfo = ocd.getTypeInfo();
-
-  // pull this object type
-  BSTR bTypeName;
-  HRESULT hr = tinfo->GetDocumentation(MEMBERID_NIL, &bTypeName, NULL, NULL, NULL);
-  if (SUCCEEDED(hr))
+  OLETRACEIN();
+  uint32_t count = ops->Length();
+  Local<Array> results = Nan::New<Array>(count);
+  HRESULT hr = interrogateType();
+  if (FAILED(hr))
   {
-    m_typeName = std::wstring(bTypeName, SysStringLen(bTypeName));
-    SysFreeString(bTypeName);
+    Nan::ThrowError(NewOleException(hr));
+    return results;
   }
-
-  TYPEATTR* tattr;
-  hr = tinfo->GetTypeAttr(&tattr);
-  if (FAILED(hr)) return hr; // can't really recover from this one
-
-  m_bHasDefaultProp = false;
-  m_members.clear();
-  
-  BSTR bMemName;
-  UINT numNames;
-
-  // pull functions and properties
-  for (int i = 0; i < tattr->cFuncs; ++i) {
-    FUNCDESC *funcdesc;
-    hr = tinfo->GetFuncDesc(i, &funcdesc);
-    if(SUCCEEDED(hr))
+  std::vector<Local<Value> > argv; // reused by every operation
+  std::vector<VARTYPE> argTypes;
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    Nan::HandleScope scope;
+    Nan::TryCatch tryCatch;
+    Local<Value> vResult = Nan::Undefined();
+    Local<Value> op, target, flags, args;
+    // a getter that throws leaves its exception in tryCatch, which puts it in the slot
+    bool bRead = Nan::Get(ops, i).ToLocal(&op) && (!op->IsArray()
+      || (Nan::Get(op.As<Object>(), 0).ToLocal(&target) && Nan::Get(op.As<Object>(), 1).ToLocal(&flags)
+      && Nan::Get(op.As<Object>(), 2).ToLocal(&args)));
+    if (bRead && (!op->IsArray() || !flags->IsUint32() || !(args->IsUndefined() || args->IsArray())))
     {
-      if (funcdesc->memid == DISPID_VALUE) m_bHasDefaultProp = true;
-      if(!(funcdesc->wFuncFlags & FUNCFLAG_FRESTRICTED))
+      Nan::ThrowTypeError("An operation must be [name | DISPID, DISPATCH_* flags, [args]]");
+    }
+    else if (bRead)
+    {
+      WORD targetType = (WORD)Nan::To<uint32_t>(flags).FromJust();
+      DISPID dispID = DISPID_UNKNOWN;
+      const MemberInfo* member = NULL;
+      hr = S_OK;
+      if (target->IsInt32())
+      {
+        dispID = (DISPID)Nan::To<int32_t>(target).FromJust();
+      }
+      else if (target->IsString())
       {
-        hr = tinfo->GetNames(funcdesc->memid, &bMemName, 1, &numNames);
-        if (SUCCEEDED(hr))
+        // names are resolved as the interceptors do: _ is the default member, get_ and put_ name the two
+        // halves of a property and must be used with the matching flags
+        MemberRef ref;
+        Local<String> name = target.As<String>();
+        bool bPut = (targetType & (DISPATCH_PROPERTYPUT | DISPATCH_PROPERTYPUTREF)) != 0;
+        if (IsDefaultPropertyName(name) && (!m_type || m_type->hasDefaultProp))
         {
-          std::wstring memberName(bMemName, SysStringLen(bMemName));
-          SysFreeString(bMemName);
-          TMemberMap::iterator lookup = m_members.find(memberName);
-          if (lookup == m_members.end())
-          {
-            lookup = m_members.insert(TMemberMap::value_type(memberName, MemberInfo())).first;
-            MemberInfo& info = lookup->second;
-            info.memberID = funcdesc->memid;
-            info.attrs = ma_IsReadOnly;
-            if (funcdesc->invkind != INVOKE_FUNC) info.attrs |= ma_IsProperty;
-            if (funcdesc->wFuncFlags & (FUNCFLAG_FHIDDEN | FUNCFLAG_FNONBROWSABLE)) info.attrs |= ma_IsHidden;
-          }
-          MemberInfo& info = lookup->second;
-          if (info.memberID == funcdesc->memid)
+          dispID = DISPID_VALUE;
+        }
+        else if (!m_type) hr = resolveName(name, &dispID);
+        else if (findMember(name, ref))
+        {
+          member = ref.member;
+          dispID = member->memberID;
+          if ((ref.kind == mk_PropertyGet && (bPut || !(targetType & DISPATCH_PROPERTYGET)))
+            || (ref.kind == mk_PropertyPut && !bPut))
           {
-            if (funcdesc->invkind == INVOKE_PROPERTYPUT || funcdesc->invkind == INVOKE_PROPERTYPUT) info.attrs &= ma_IsReadOnly;
-            if (funcdesc->invkind == INVOKE_PROPERTYGET && funcdesc->cParams) info.attrs |= ma_IsIndexedProperty;
+            hr = DISP_E_MEMBERNOTFOUND;
           }
         }
+        else hr = DISP_E_UNKNOWNNAME;
+      } else {
+        hr = E_INVALIDARG;
+      }
+      int argc = args->IsArray() ? (int)args.As<Array>()->Length() : 0;
+      argv.resize(argc + 1);
+      argTypes.resize(argc + 1);
+      for (int idx = 0; idx < argc && bRead; ++idx) bRead = Nan::Get(args.As<Object>(), idx).ToLocal(&argv[idx]);
+      if (!bRead)
+      {
+        // an argument's getter threw
+      }
+      else if (FAILED(hr))
+      {
+        Nan::ThrowError(NewOleException(hr));
+      }
+      else if (targetType & (DISPATCH_PROPERTYPUT | DISPATCH_PROPERTYPUTREF))
+      {
+        OLESet(dispID, argc, &argv[0], member);
+      }
+      else if (targetType == DISPATCH_PROPERTYGET)
+      {
+        vResult = OLEGet(dispID, argc, &argv[0], member);
+      } else {
+        hr = declaredTypes(member, targetType, argc, &argv[0], &argTypes[0]);
+        if (FAILED(hr)) Nan::ThrowError(NewOleException(hr));
+        else vResult = OLECall(dispID, argc, &argv[0], targetType, hr == S_OK ? &argTypes[0] : NULL);
       }
-      tinfo->ReleaseFuncDesc(funcdesc);
     }
+    if (tryCatch.HasCaught()) vResult = tryCatch.Exception();
+    Nan::Set(results, i, vResult);
   }
+  OLETRACEOUT();
+  return results;
+}
 
-  for (int i = 0; i < tattr->cVars; ++i) {
-    VARDESC *vardesc;
-    hr = tinfo->GetVarDesc(i, &vardesc);
-    if (SUCCEEDED(hr))
+Local<Value> V8Dispatch::OLECallAsync(Local<String> name, int argc, Local<Value> argv[])
+{
+  OLETRACEIN();
+  HRESULT hr = interrogateType();
+  DISPID dispID = DISPID_UNKNOWN;
+  const MemberInfo* member = NULL;
+  WORD targetType = DISPATCH_METHOD | DISPATCH_PROPERTYGET;
+  if (SUCCEEDED(hr))
+  {
+    if (IsDefaultPropertyName(name) && (!m_type || m_type->hasDefaultProp))
+    {
+      dispID = DISPID_VALUE;
+    }
+    else if (m_type)
     {
-      if (vardesc->memid == DISPID_VALUE) m_bHasDefaultProp = true;
-      if(!(vardesc->wVarFlags & VARFLAG_FRESTRICTED))
+      // get_ and put_ name the two halves of a property
+      MemberRef ref;
+      if (findMember(name, ref))
       {
-        hr = tinfo->GetNames(vardesc->memid, &bMemName, 1, &numNames);
-        if (SUCCEEDED(hr))
+        member = ref.member;
+        dispID = member->memberID;
+        if (ref.kind == mk_PropertyGet) targetType = DISPATCH_PROPERTYGET;
+        else if (ref.kind == mk_PropertyPut) targetType = DISPATCH_PROPERTYPUT;
+      } else {
+        hr = DISP_E_UNKNOWNNAME;
+      }
+    } else {
+      hr = resolveName(name, &dispID);
+    }
+  }
+  VARTYPE* argTypes = (VARTYPE*)alloca(sizeof(VARTYPE) * (argc + 1));
+  if (SUCCEEDED(hr)) hr = declaredTypes(member, targetType, argc, argv, argTypes);
+  if (FAILED(hr))
+  {
+    Nan::ThrowError(NewOleException(hr));
+    return Nan::Undefined();
+  }
+  // the arguments outlive this call, they are freed once it has completed
+  VARIANT* args = argc ? new VARIANT[argc] : NULL;
+  if (!MarshalArguments(argc, argv, hr == S_OK ? argTypes : NULL, args, false))
+  {
+    delete[] args;
+    return Nan::Undefined();
+  }
+
+  // placed objects are called on their own thread, where no marshaling is needed
+  OCApartment* apartment = m_apartment ? CallingApartment(m_apartment) : isAgile() ? AsyncWorker() : NULL;
+  OCGlobalRef* shared;
+  if (apartment && SUCCEEDED(sharedRef(&shared)))
+  {
+    Local<Value> vPromise = StartAsyncCall(apartment, shared, dispID, targetType, argc, args);
+    shared->Release();
+    return vPromise;
+  }
+  // only our apartment can call the object, and it doesn't pump messages for anybody else: call it now
+  ErrorInfo errInfo;
+  errInfo.wCode = 0;
+  errInfo.scode = 0;
+  errInfo.dwHelpContext = 0;
+  VARIANT result;
+  VariantInit(&result);
+  hr = invoke(targetType, dispID, &result, errInfo, argc, args);
+  OLETRACEOUT();
+  return SettledCall(hr, errInfo, result, argc, args);
+}
+
+bool V8Dispatch::isAgile()
+{
+  if (m_agility < 0 && ocd.disp)
+  {
+    m_agility = 0;
+    // a proxy: every apartment can have its own to the same server
+    IUnknown* security = NULL;
+    if (SUCCEEDED(ocd.disp->QueryInterface(IID_IClientSecurity, (void**)&security)) && security)
+    {
+      security->Release();
+      m_agility = 1;
+    } else {
+      // the free-threaded marshaler hands out the object itself
+      IMarshal* marshal = NULL;
+      if (SUCCEEDED(ocd.disp->QueryInterface(IID_IMarshal, (void**)&marshal)) && marshal)
+      {
+        CLSID clsid;
+        if (SUCCEEDED(marshal->GetUnmarshalClass(IID_IDispatch, ocd.disp, MSHCTX_INPROC, NULL, MSHLFLAGS_NORMAL, &clsid))
+          && IsEqualCLSID(clsid, CLSID_FreeThreadedMarshaler))
         {
-          std::wstring memberName(bMemName, SysStringLen(bMemName));
-          SysFreeString(bMemName);
-          if(m_members.find(memberName) == m_members.end())
-          {
-            MemberInfo& info = m_members.insert(TMemberMap::value_type(memberName, MemberInfo())).first->second;
-            info.memberID = vardesc->memid;
-            info.attrs = ma_IsProperty;
-            if (vardesc->wVarFlags & VARFLAG_FREADONLY) info.attrs |= ma_IsReadOnly;
-            if (vardesc->wVarFlags & (VARFLAG_FHIDDEN | VARFLAG_FNONBROWSABLE)) info.attrs |= ma_IsHidden;
-          }
+          m_agility = 1;
         }
+        marshal->Release();
+      }
+    }
+  }
+  return m_agility > 0;
+}
+
+HRESULT V8Dispatch::sharedRef(OCGlobalRef** ppRef)
+{
+  if (!m_shared)
+  {
+    if (!ocd.disp) return E_POINTER;
+    HRESULT hr = OCGlobalRef::create(ocd.disp, IID_IDispatch, &m_shared);
+    if (FAILED(hr)) return hr;
+  }
+  m_shared->AddRef();
+  *ppRef = m_shared;
+  return S_OK;
+}
+
+void V8Dispatch::setApartment(OCApartment* apartment, OCGlobalRef* shared)
+{
+  if (m_apartment) m_apartment->leave();
+  m_apartment = apartment;
+  if (m_apartment) m_apartment->enter();
+  if (shared)
+  {
+    shared->AddRef();
+    if (m_shared) m_shared->Release();
+    m_shared = shared;
+  }
+}
+
+NAN_GETTER(V8Dispatch::OLEAsyncGet)
+{
+  OLETRACEIN();
+  Local<Object> thisObject = info.This();
+  V8Dispatch *vThis = V8Dispatch::Unwrap<V8Dispatch>(thisObject);
+  CHECK_V8(V8Dispatch, vThis);
+  Local<Object> vAsync;
+  if (!vThis->findWrapper(thisObject, wk_Async, DISPID_UNKNOWN, vAsync))
+  {
+    MaybeLocal<Object> mAsync = V8DispAsync::CreateNew(thisObject);
+    if (mAsync.IsEmpty()) return;
+    vAsync = mAsync.ToLocalChecked();
+    vThis->keepWrapper(thisObject, wk_Async, DISPID_UNKNOWN, vAsync);
+  }
+  OLETRACEOUT();
+  return info.GetReturnValue().Set(vAsync);
+}
+
+NAN_METHOD(V8Dispatch::OLEDispID)
+{
+  OLETRACEIN();
+  V8Dispatch *vThis = V8Dispatch::Unwrap<V8Dispatch>(info.This());
+  CHECK_V8(V8Dispatch, vThis);
+  if (info.Length() < 1 || !info[0]->IsString())
+    return Nan::ThrowTypeError("Argument 1 is not a String");
+  Local<String> name = Local<String>::Cast(info[0]);
+  HRESULT hr = vThis->interrogateType();
+  DISPID dispID = DISPID_UNKNOWN;
+  if (SUCCEEDED(hr))
+  {
+    if (IsDefaultPropertyName(name))
+    {
+      dispID = DISPID_VALUE;
+    }
+    else if (vThis->m_type)
+    {
+      MemberRef ref;
+      if (vThis->findMember(name, ref)) dispID = ref.member->memberID;
+      else hr = DISP_E_UNKNOWNNAME;
+    } else {
+      hr = vThis->resolveName(name, &dispID);
+    }
+  }
+  if (FAILED(hr)) return Nan::ThrowError(NewOleException(hr));
+  OLETRACEOUT();
+  return info.GetReturnValue().Set(Nan::New<Int32>((int32_t)dispID));
+}
+
+NAN_METHOD(V8Dispatch::OLEInvoke)
+{
+  OLETRACEIN();
+  OLETRACEARGS();
+  V8Dispatch *vThis = V8Dispatch::Unwrap<V8Dispatch>(info.This());
+  CHECK_V8(V8Dispatch, vThis);
+  if (info.Length() < 2 || !info[0]->IsInt32())
+    return Nan::ThrowTypeError("Argument 1 is not a DISPID");
+  if (!info[1]->IsUint32())
+    return Nan::ThrowTypeError("Argument 2 is not a DISPATCH_* flag");
+  DISPID dispID = (DISPID)Nan::To<int32_t>(info[0]).FromJust();
+  WORD targetType = (WORD)Nan::To<uint32_t>(info[1]).FromJust();
+  int argc = info.Length() - 2;
+  Local<Value>* argv = (Local<Value>*)alloca(sizeof(Local<Value>) * (argc ? argc : 1));
+  for (int idx = 0; idx < argc; ++idx)
+  {
+    *(new(argv + idx) Local<Value>) = info[2 + idx];
+  }
+  Local<Value> vResult = vThis->OLECall(dispID, argc, argv, targetType);
+  for (int idx = 0; idx < argc; ++idx)
+  {
+    (argv + idx)->~Local<Value>();
+  }
+  if (!vResult->IsUndefined()) info.GetReturnValue().Set(vResult);
+  OLETRACEOUT();
+}
+
+HRESULT V8Dispatch::invoke(WORD targetType, DISPID propID, VARIANT* pvResult, ErrorInfo& errInfo, int argc, VARIANT* args)
+{
+  if (!module_options.vtableCalls || !ocd.disp) return ocd.invoke(targetType, propID, pvResult, errInfo, argc, args);
+  if (!m_bVtblChecked)
+  {
+    m_bVtblChecked = true;
+    // proxies marshal every call anyway, and DispCallFunc can't go through them
+    IUnknown* security = NULL;
+    if (SUCCEEDED(ocd.disp->QueryInterface(IID_IClientSecurity, (void**)&security)) && security)
+    {
+      security->Release();
+    }
+    else if (OCVtable::lookup(ocd.getTypeInfo(), &m_vtbl) == S_OK)
+    {
+      if (FAILED(ocd.disp->QueryInterface(m_vtbl->iid, (void**)&m_vtblTarget)) || !m_vtblTarget)
+      {
+        m_vtblTarget = NULL;
+        m_vtbl->Release();
+        m_vtbl = NULL;
       }
-      tinfo->ReleaseVarDesc(vardesc);
     }
   }
+  if (!m_vtbl) return ocd.invoke(targetType, propID, pvResult, errInfo, argc, args);
+
+  // same choice between put and putref as ocd.invoke makes
+  WORD kind = targetType;
+  if ((kind & DISPATCH_PROPERTYPUT) && argc && args[0].vt == VT_DISPATCH)
+  {
+    kind = (kind & ~DISPATCH_PROPERTYPUT) | DISPATCH_PROPERTYPUTREF;
+  }
+  const OCVtable::Entry* entry = m_vtbl->find(propID, kind);
+  if (!entry || entry->paramCount != argc) return ocd.invoke(targetType, propID, pvResult, errInfo, argc, args);
+
+  // the arguments have to be exactly of the declared types (and in declaration order),
+  // if one can't be we let Invoke sort it out
+  VARIANT* declared = argc ? (VARIANT*)alloca(sizeof(VARIANT) * argc) : NULL;
+  int converted = 0;
+  for (; converted < argc; ++converted)
+  {
+    VARIANT& arg = args[argc - converted - 1];
+    VariantInit(&declared[converted]);
+    VARTYPE vt = entry->paramTypes[converted];
+    if (arg.vt == VT_ERROR && vt != VT_ERROR && vt != VT_VARIANT) break; // omitted
+    if (arg.vt == vt || vt == VT_VARIANT)
+    {
+      declared[converted] = arg; // borrowed, the callee only reads [in] arguments
+      continue;
+    }
+    if (FAILED(VariantChangeType(&declared[converted], &arg, 0, vt))) break;
+    V8Variant::ClearArgument(arg);
+    arg = declared[converted]; // args own the converted value from now on
+  }
+  if (converted < argc) return ocd.invoke(targetType, propID, pvResult, errInfo, argc, args);
+  return m_vtbl->call(m_vtblTarget, *entry, declared, pvResult, errInfo);
+}
+
+HRESULT V8Dispatch::interrogateType()
+{
+  if (m_bInterrogated || !ocd.disp) return S_FALSE;
+  ITypeInfo* tinfo = ocd.getTypeInfo();
 
-  tinfo->ReleaseTypeAttr(tattr);
+  // objects of the same type share one member table, only the first one pays for walking the ITypeInfo
+  HRESULT hr = OCTypeCache::lookup(tinfo, LOCALE_USER_DEFAULT, module_options.lazyBinding, &m_type);
+  if (FAILED(hr)) return hr;
+  m_bInterrogated = true;
+  if (!m_type) attachNameCache();
   return S_OK;
 }
 
+void V8Dispatch::setNameCacheMode(int mode, const CLSID* clsid)
+{
+  m_nameCacheMode = mode;
+  m_bHasClsid = clsid != NULL;
+  if (clsid) m_clsid = *clsid;
+}
+
+void V8Dispatch::attachNameCache()
+{
+  if (m_names || m_nameCacheMode == nc_None || !ocd.disp) return;
+
+  // IDispatchEx servers can add members at any time, never share their names or remember failures
+  IDispatchEx* dispEx = NULL;
+  if (SUCCEEDED(ocd.disp->QueryInterface(IID_IDispatchEx, (void**)&dispEx)) && dispEx)
+  {
+    dispEx->Release();
+    m_names = new OCNameCache(false);
+    return;
+  }
+
+  if (m_nameCacheMode == nc_Shared && !m_bHasClsid)
+  {
+    IPersist* persist = NULL;
+    if (SUCCEEDED(ocd.disp->QueryInterface(IID_IPersist, (void**)&persist)) && persist)
+    {
+      m_bHasClsid = SUCCEEDED(persist->GetClassID(&m_clsid));
+      persist->Release();
+    }
+  }
+  if (m_nameCacheMode == nc_Shared && m_bHasClsid)
+  {
+    m_names = OCNameCache::getShared(m_clsid);
+  } else {
+    m_names = new OCNameCache();
+  }
+}
+
+HRESULT V8Dispatch::resolveName(Local<String> property, DISPID* pid)
+{
+  String::Value vProperty(property);
+  const wchar_t* szName = (const wchar_t*)*vProperty;
+  size_t len = vProperty.length();
+  if (m_names)
+  {
+    HRESULT hr = m_names->find(szName, len, pid);
+    if (hr != S_FALSE) return hr;
+  }
+
+  BSTR bName = ::SysAllocStringLen(szName, (UINT)len);
+  if (!bName) return E_OUTOFMEMORY;
+  HRESULT hr = ocd.disp->GetIDsOfNames(IID_NULL, &bName, 1, LOCALE_USER_DEFAULT, pid);
+  ::SysFreeString(bName);
+  if (m_names) m_names->insert(szName, len, hr, *pid);
+  return hr;
+}
+
+bool V8Dispatch::findMember(Local<String> property, MemberRef& result)
+{
+  unsigned slot = ((unsigned)property->GetIdentityHash() ^ (unsigned)((uintptr_t)m_type >> 4)) & (NAME_CACHE_SIZE - 1);
+  NameCacheEntry& entry = nameCache[slot];
+  if (entry.type == m_type && Nan::New(entry.name)->StrictEquals(property))
+  {
+    result = entry.ref;
+    return result.member != NULL;
+  }
+
+  String::Value vProperty(property);
+  if (!m_type->find((const wchar_t*)*vProperty, vProperty.length(), result))
+  {
+    // remember misses too, the interceptor sees every "constructor", "valueOf", etc.
+    result.name = NULL;
+    result.member = NULL;
+    result.kind = mk_Member;
+  }
+  m_type->AddRef();
+  if (entry.type) entry.type->Release();
+  entry.type = m_type;
+  entry.name.Reset(property);
+  entry.ref = result;
+  return result.member != NULL;
+}
+
+bool V8Dispatch::findWrapper(Local<Object> thisObject, int kind, DISPID id, Local<Object>& wrapper)
+{
+  TWrapperSlots::const_iterator found = m_wrapperSlots.find(std::make_pair(id, kind));
+  if (found == m_wrapperSlots.end()) return false;
+  Local<Value> slot = Nan::Get(thisObject->GetInternalField(1).As<Object>(), found->second).ToLocalChecked();
+  if (!slot->IsObject()) return false;
+  wrapper = slot.As<Object>();
+  return true;
+}
+
+void V8Dispatch::keepWrapper(Local<Object> thisObject, int kind, DISPID id, Local<Object> wrapper)
+{
+  // the wrappers are held from a JS array rather than persistent handles, they point back at
+  // this object and the garbage collector has to see that cycle
+  Local<Value> field = thisObject->GetInternalField(1);
+  Local<Array> slots;
+  if (field->IsArray())
+  {
+    slots = field.As<Array>();
+  } else {
+    slots = Nan::New<Array>();
+    thisObject->SetInternalField(1, slots);
+  }
+  uint32_t idx = (uint32_t)m_wrapperSlots.size();
+  if (!m_wrapperSlots.insert(TWrapperSlots::value_type(std::make_pair(id, kind), idx)).second) return;
+  Nan::Set(slots, idx, wrapper);
+}
+
+const std::wstring& V8Dispatch::typeName() const
+{
+  static const std::wstring noTypeName;
+  return m_type ? m_type->typeName : noTypeName;
+}
+
 NAN_PROPERTY_GETTER(V8Dispatch::OLEGetAttr)
 {
   OLETRACEIN();
@@ -342,9 +979,7 @@ NAN_PROPERTY_GETTER(V8Dispatch::OLEGetAttr)
   HRESULT hr = vThis->interrogateType();
   if (FAILED(hr)) return Nan::ThrowError(NewOleException(hr));
 
-  String::Value vProperty(property);
-  const wchar_t* szProperty = (const wchar_t*)*vProperty;
-  if (wcscmp(szProperty, L"_") == 0 && (vThis->m_members.empty() || vThis->m_bHasDefaultProp))
+  if (IsDefaultPropertyName(property) && (!vThis->m_type || vThis->m_type->hasDefaultProp))
   {
     Local<Value> vResult = vThis->OLEGet(DISPID_VALUE);
     if (vResult->IsUndefined()) return; // exception?
@@ -352,82 +987,67 @@ NAN_PROPERTY_GETTER(V8Dispatch::OLEGetAttr)
   }
 
   // try to resolve this as a member of our object
-  if (vThis->m_members.empty())
+  if (!vThis->m_type)
   { // no type information, we're running blind
-    BSTR bName = ::SysAllocString(szProperty);
-    if (bName)
+    DISPID dispID;
+    HRESULT hr = vThis->resolveName(property, &dispID);
+    if (SUCCEEDED(hr))
     {
-      DISPID dispID;
-      HRESULT hr = vThis->ocd.disp->GetIDsOfNames(IID_NULL, &bName, 1, LOCALE_USER_DEFAULT, &dispID);
-      ::SysFreeString(bName);
-      if (SUCCEEDED(hr))
+      Local<Object> vDispMember;
+      if (!vThis->findWrapper(thisObject, wk_Member, dispID, vDispMember))
       {
-        MaybeLocal<Object> vDispMember = V8DispMember::CreateNew(thisObject, dispID);
-        if(!vDispMember.IsEmpty()) info.GetReturnValue().Set(vDispMember.ToLocalChecked());
-        return;
+        MaybeLocal<Object> mDispMember = V8DispMember::CreateNew(thisObject, dispID);
+        if (mDispMember.IsEmpty()) return;
+        vDispMember = mDispMember.ToLocalChecked();
+        vThis->keepWrapper(thisObject, wk_Member, dispID, vDispMember);
       }
+      return info.GetReturnValue().Set(vDispMember);
     }
   }
   else
   {
-    TMemberMap::const_iterator lookup = vThis->m_members.find(szProperty);
-    if (lookup != vThis->m_members.end())
+    MemberRef ref;
+    if (vThis->findMember(property, ref))
     {
-      const std::wstring& memberName = lookup->first;
-      const MemberInfo& minfo = lookup->second;
-      if (minfo.attrs & ma_IsProperty)
+      const MemberInfo& minfo = *ref.member;
+      if (ref.kind == mk_Member && (minfo.attrs & ma_IsProperty) && !(minfo.attrs & ma_IsIndexedProperty))
       {
-        if (minfo.attrs & ma_IsIndexedProperty)
-        {
-          // create indexed property object here
-          MaybeLocal<Object> vDispIdxProp = V8DispIdxProperty::CreateNew(thisObject, Nan::New((const uint16_t*)memberName.c_str()).ToLocalChecked(), minfo.memberID);
-          if(!vDispIdxProp.IsEmpty()) info.GetReturnValue().Set(vDispIdxProp.ToLocalChecked());
-          return;
-        } else {
-          // fetch property value now
-          Local<Value> vResult = vThis->OLEGet(minfo.memberID);
-          if (vResult->IsUndefined()) return; // exception?
-          return info.GetReturnValue().Set(vResult);
-        }
-      } else {
-        // create method property object here
-        MaybeLocal<Object> vDispMethod = V8DispMethod::CreateNew(thisObject, DISPATCH_METHOD, Nan::New((const uint16_t*)memberName.c_str()).ToLocalChecked(), minfo.memberID);
-        if(!vDispMethod.IsEmpty()) info.GetReturnValue().Set(vDispMethod.ToLocalChecked());
-        return;
+        // fetch property value now
+        Local<Value> vResult = vThis->OLEGet(minfo.memberID);
+        if (vResult->IsUndefined()) return; // exception?
+        return info.GetReturnValue().Set(vResult);
       }
-    }
-    if(wcsnicmp(szProperty, L"get_", 4) == 0)
-    {
-      TMemberMap::const_iterator lookup = vThis->m_members.find(szProperty + 4);
-      if (lookup != vThis->m_members.end())
+
+      int kind;
+      switch (ref.kind)
       {
-        const std::wstring& memberName = lookup->first;
-        const MemberInfo& minfo = lookup->second;
-        if (minfo.attrs & ma_IsProperty)
-        {
-          // create method property object here
-          MaybeLocal<Object> vDispMethod = V8DispMethod::CreateNew(thisObject, DISPATCH_PROPERTYGET, Nan::New((const uint16_t*)memberName.c_str()).ToLocalChecked(), minfo.memberID);
-          if(!vDispMethod.IsEmpty()) info.GetReturnValue().Set(vDispMethod.ToLocalChecked());
-          return;
-        }
+      case mk_PropertyGet: kind = wk_PropertyGet; break;
+      case mk_PropertyPut: kind = wk_PropertyPut; break;
+      default: kind = minfo.attrs & ma_IsProperty ? wk_IdxProperty : wk_Method; break;
       }
-    }
-    if (wcsnicmp(szProperty, L"put_", 4) == 0)
-    {
-      TMemberMap::const_iterator lookup = vThis->m_members.find(szProperty + 4);
-      if (lookup != vThis->m_members.end())
+      Local<Object> vWrapper;
+      if (!vThis->findWrapper(thisObject, kind, minfo.memberID, vWrapper))
       {
-        const std::wstring& memberName = lookup->first;
-        const MemberInfo& minfo = lookup->second;
-        if (minfo.attrs & ma_IsProperty)
+        Local<String> vName = Nan::New((const uint16_t*)ref.name->c_str()).ToLocalChecked();
+        MaybeLocal<Object> mWrapper;
+        switch (kind)
         {
-          // create method property object here
-          MaybeLocal<Object> vDispMethod = V8DispMethod::CreateNew(thisObject, DISPATCH_PROPERTYPUT, Nan::New((const uint16_t*)memberName.c_str()).ToLocalChecked(), minfo.memberID);
-          if(!vDispMethod.IsEmpty()) info.GetReturnValue().Set(vDispMethod.ToLocalChecked());
-          return;
+        case wk_IdxProperty: // create indexed property object here
+          mWrapper = V8DispIdxProperty::CreateNew(thisObject, vName, minfo.memberID, &minfo);
+          break;
+        case wk_Method: // create method property object here
+          mWrapper = V8DispMethod::CreateNew(thisObject, DISPATCH_METHOD, vName, minfo.memberID, &minfo);
+          break;
+        default:
+          mWrapper = V8DispMethod::CreateNew(thisObject, kind == wk_PropertyGet ? DISPATCH_PROPERTYGET : DISPATCH_PROPERTYPUT, vName, minfo.memberID, &minfo);
+          break;
         }
+        if (mWrapper.IsEmpty()) return;
+        vWrapper = mWrapper.ToLocalChecked();
+        vThis->keepWrapper(thisObject, kind, minfo.memberID, vWrapper);
       }
-	}
+      return info.GetReturnValue().Set(vWrapper);
+    }
   }
 
   // try to retrieve it as an existing property of the js object
@@ -457,35 +1077,32 @@ NAN_PROPERTY_SETTER(V8Dispatch::OLESetAttr)
   V8Dispatch *vThis = V8Dispatch::Unwrap<V8Dispatch>(thisObject);
   CHECK_V8(V8Dispatch, vThis);
 
-  String::Value vProperty(property);
-  if (wcscmp((const wchar_t*)*vProperty, L"_") == 0 && (vThis->m_members.empty() || vThis->m_bHasDefaultProp))
+  HRESULT hr = vThis->interrogateType();
+  if (FAILED(hr)) return Nan::ThrowError(NewOleException(hr));
+
+  if (IsDefaultPropertyName(property) && (!vThis->m_type || vThis->m_type->hasDefaultProp))
   {
     bool bResult = vThis->OLESet(DISPID_VALUE, 1, &value);
     return info.GetReturnValue().Set(bResult);
   }
 
   // try to resolve this as a member of our object
-  if (vThis->m_members.empty())
+  if (!vThis->m_type)
   { // no type information, we're running blind
-    BSTR bName = ::SysAllocString((const wchar_t*)*vProperty);
-    if (bName)
+    DISPID dispID;
+    HRESULT hr = vThis->resolveName(property, &dispID);
+    if (SUCCEEDED(hr))
     {
-      DISPID dispID;
-      HRESULT hr = vThis->ocd.disp->GetIDsOfNames(IID_NULL, &bName, 1, LOCALE_USER_DEFAULT, &dispID);
-      ::SysFreeString(bName);
-      if (SUCCEEDED(hr))
-      {
-        bool bResult = vThis->OLESet(dispID, 1, &value);
-        return info.GetReturnValue().Set(bResult);
-      }
+      bool bResult = vThis->OLESet(dispID, 1, &value);
+      return info.GetReturnValue().Set(bResult);
     }
   }
   else
   {
-    TMemberMap::const_iterator lookup = vThis->m_members.find((const wchar_t*)*vProperty);
-    if (lookup != vThis->m_members.end())
+    MemberRef ref;
+    if (vThis->findMember(property, ref) && ref.kind == mk_Member)
     {
-      const MemberInfo& minfo = lookup->second;
+      const MemberInfo& minfo = *ref.member;
       if (minfo.attrs & ma_IsProperty)
       {
         if (minfo.attrs & ma_IsIndexedProperty)
@@ -493,7 +1110,7 @@ NAN_PROPERTY_SETTER(V8Dispatch::OLESetAttr)
           return Nan::ThrowError("Cannot set this property without an index");
         } else {
           // set property value now
-          bool bResult = vThis->OLESet(minfo.memberID, 1, &value);
+          bool bResult = vThis->OLESet(minfo.memberID, 1, &value, &minfo);
           return info.GetReturnValue().Set(bResult);
         }
       } else {
@@ -534,14 +1151,20 @@ NAN_PROPERTY_ENUMERATOR(V8Dispatch::OLEEnumAttr)
   typedef std::set<std::wstring> TStringSet;
   TStringSet props;
 
-  if (vThis->m_members.empty() || vThis->m_bHasDefaultProp)
+  if (!vThis->m_type || vThis->m_type->hasDefaultProp)
   {
     props.insert(L"_");
   }
 
-  for (TMemberMap::const_iterator trans = vThis->m_members.begin(); trans != vThis->m_members.end(); trans++)
+  if (vThis->m_type)
   {
-    props.insert(trans->first);
+    // a lazily bound type only knows the names used so far
+    hr = vThis->m_type->enumerate();
+    if (FAILED(hr)) return Nan::ThrowError(NewOleException(hr));
+    for (OCTypeMembers::TMemberMap::const_iterator trans = vThis->m_type->members.begin(); trans != vThis->m_type->members.end(); trans++)
+    {
+      props.insert(trans->first);
+    }
   }
 
   if (!props.empty())
@@ -574,20 +1197,16 @@ NAN_PROPERTY_QUERY(V8Dispatch::OLEQueryAttr)
   HRESULT hr = vThis->interrogateType();
   if (FAILED(hr)) return Nan::ThrowError(NewOleException(hr));
 
-  typedef std::set<std::wstring> TStringSet;
-  TStringSet props;
-
-  String::Value vProperty(property);
-  if (wcscmp((const wchar_t*)*vProperty, L"_") == 0 && (vThis->m_members.empty() || vThis->m_bHasDefaultProp))
+  if (IsDefaultPropertyName(property) && (!vThis->m_type || vThis->m_type->hasDefaultProp))
   { // TODO: is the default property r/o ?
     return info.GetReturnValue().Set(PropertyAttribute::DontDelete | PropertyAttribute::DontEnum);
   }
 
   // try to resolve this as a member of our object
-  TMemberMap::const_iterator lookup = vThis->m_members.find((const wchar_t*)*vProperty);
-  if (lookup != vThis->m_members.end())
+  MemberRef ref;
+  if (vThis->m_type && vThis->findMember(property, ref) && ref.kind == mk_Member)
   {
-    const MemberInfo& minfo = lookup->second;
+    const MemberInfo& minfo = *ref.member;
     return info.GetReturnValue().Set(
       PropertyAttribute::DontDelete |
       (minfo.attrs & ma_IsReadOnly ? PropertyAttribute::ReadOnly : 0) |
@@ -612,7 +1231,7 @@ NAN_INDEX_GETTER(V8Dispatch::OLEGetIdxAttr)
   HRESULT hr = vThis->interrogateType();
   if (FAILED(hr)) return Nan::ThrowError(NewOleException(hr));
 
-  if (vThis->m_members.empty() || vThis->m_bHasDefaultProp)
+  if (!vThis->m_type || vThis->m_type->hasDefaultProp)
   {
     // we either have no type information or we know there is a default property here, let's assume it's indexed
     Handle<Value> argv[] = { Nan::New(index) };
@@ -642,7 +1261,7 @@ NAN_INDEX_SETTER(V8Dispatch::OLESetIdxAttr)
   HRESULT hr = vThis->interrogateType();
   if (FAILED(hr)) return Nan::ThrowError(NewOleException(hr));
 
-  if (vThis->m_members.empty() || vThis->m_bHasDefaultProp)
+  if (!vThis->m_type || vThis->m_type->hasDefaultProp)
   {
     // we either have no type information or we know there is a default property here, let's assume it's indexed
     Handle<Value> argv[] = { Nan::New(index), value };
@@ -659,6 +1278,85 @@ NAN_INDEX_SETTER(V8Dispatch::OLESetIdxAttr)
   return Nan::ThrowError("Cannot assign new properties to this object");
 }
 
+NAN_GETTER(V8Dispatch::OLETypedGet)
+{
+  OLETRACEIN();
+  V8Dispatch *vThis = V8Dispatch::Unwrap<V8Dispatch>(info.Holder());
+  CHECK_V8(V8Dispatch, vThis);
+  Local<Value> vResult = vThis->OLEGet(TypedMember(info.Data())->memberID);
+  if (vResult->IsUndefined()) return; // exception?
+  OLETRACEOUT();
+  return info.GetReturnValue().Set(vResult);
+}
+
+NAN_SETTER(V8Dispatch::OLETypedSet)
+{
+  OLETRACEIN();
+  V8Dispatch *vThis = V8Dispatch::Unwrap<V8Dispatch>(info.Holder());
+  CHECK_V8(V8Dispatch, vThis);
+  const MemberInfo* member = TypedMember(info.Data());
+  vThis->OLESet(member->memberID, 1, &value, member);
+  OLETRACEOUT();
+}
+
+NAN_GETTER(V8Dispatch::OLETypedIdxGet)
+{
+  OLETRACEIN();
+  Local<Object> thisObject = info.Holder();
+  V8Dispatch *vThis = V8Dispatch::Unwrap<V8Dispatch>(thisObject);
+  CHECK_V8(V8Dispatch, vThis);
+  const MemberInfo* member = TypedMember(info.Data());
+  DISPID dispID = member->memberID;
+  Local<Object> vDispIdxProp;
+  if (!vThis->findWrapper(thisObject, wk_IdxProperty, dispID, vDispIdxProp))
+  {
+    MaybeLocal<Object> mDispIdxProp = V8DispIdxProperty::CreateNew(thisObject, property, dispID, member);
+    if (mDispIdxProp.IsEmpty()) return;
+    vDispIdxProp = mDispIdxProp.ToLocalChecked();
+    vThis->keepWrapper(thisObject, wk_IdxProperty, dispID, vDispIdxProp);
+  }
+  OLETRACEOUT();
+  return info.GetReturnValue().Set(vDispIdxProp);
+}
+
+NAN_SETTER(V8Dispatch::OLETypedIdxSet)
+{
+  return Nan::ThrowError("Cannot set this property without an index");
+}
+
+NAN_METHOD(V8Dispatch::OLETypedCall)
+{
+  OLETRACEIN();
+  V8Dispatch *vThis = V8Dispatch::Unwrap<V8Dispatch>(info.This());
+  CHECK_V8(V8Dispatch, vThis);
+  const MemberInfo* member = TypedMember(info.Data());
+  Local<Value> vResult = vThis->OLECall(member->memberID, info, DISPATCH_METHOD | DISPATCH_PROPERTYGET, member);
+  OLETRACEOUT();
+  return info.GetReturnValue().Set(vResult);
+}
+
+NAN_METHOD(V8Dispatch::OLETypedPropGet)
+{
+  OLETRACEIN();
+  V8Dispatch *vThis = V8Dispatch::Unwrap<V8Dispatch>(info.This());
+  CHECK_V8(V8Dispatch, vThis);
+  const MemberInfo* member = TypedMember(info.Data());
+  Local<Value> vResult = vThis->OLECall(member->memberID, info, DISPATCH_PROPERTYGET, member);
+  OLETRACEOUT();
+  return info.GetReturnValue().Set(vResult);
+}
+
+NAN_METHOD(V8Dispatch::OLETypedPropPut)
+{
+  OLETRACEIN();
+  V8Dispatch *vThis = V8Dispatch::Unwrap<V8Dispatch>(info.This());
+  CHECK_V8(V8Dispatch, vThis);
+  const MemberInfo* member = TypedMember(info.Data());
+  Local<Value> vResult = vThis->OLECall(member->memberID, info, DISPATCH_PROPERTYPUT, member);
+  OLETRACEOUT();
+  return info.GetReturnValue().Set(vResult);
+}
+
 NAN_METHOD(V8Dispatch::Finalize)
 {
   DISPFUNCIN();
@@ -675,7 +1373,37 @@ void V8Dispatch::Finalize()
 {
   if(!finalized)
   {
+    if (m_shared)
+    {
+      m_shared->Release(); // calls still running keep their own reference
+      m_shared = NULL;
+    }
+    if (m_apartment)
+    {
+      m_apartment->leave();
+      m_apartment = NULL;
+    }
+    if (m_vtblTarget)
+    {
+      m_vtblTarget->Release();
+      m_vtblTarget = NULL;
+    }
+    if (m_vtbl)
+    {
+      m_vtbl->Release();
+      m_vtbl = NULL;
+    }
     ocd.Clear();
+    if (m_type)
+    {
+      m_type->Release();
+      m_type = NULL;
+    }
+    if (m_names)
+    {
+      m_names->Release();
+      m_names = NULL;
+    }
     finalized = true;
   }
 }
@@ -1,12 +1,14 @@
 #ifndef __V8DISPATCH_H__
 #define __V8DISPATCH_H__
 
-#include <functional>
-#include <map>
 #include <nan.h>
 #include <node.h>
+#include <map>
 #include "node_win32ole.h"
 #include "ole32core.h"
+#include "oletypeinfo.h"
+#include "olevtable.h"
+#include "oleapartment.h"
 
 namespace node_win32ole {
 
@@ -14,6 +16,7 @@ class V8Dispatch : public node::ObjectWrap {
 public:
   static Nan::Persistent<FunctionTemplate> clazz;
   static void Init(Nan::ADDON_REGISTER_FUNCTION_ARGS_TYPE target);
+  static void ClearTypeCaches(); // the classes and names kept per member table, along with OCTypeCache::clear()
   static NAN_METHOD(OLEValue);
   static NAN_METHOD(OLEPrimitiveValue);
   static NAN_METHOD(OLEStringValue);
@@ -26,53 +29,97 @@ public:
   static NAN_PROPERTY_QUERY(OLEQueryAttr);
   static NAN_INDEX_GETTER(OLEGetIdxAttr);
   static NAN_INDEX_SETTER(OLESetIdxAttr);
+  static NAN_GETTER(OLETypedGet); // the accessors and methods of typed classes carry their MemberInfo as data
+  static NAN_SETTER(OLETypedSet);
+  static NAN_GETTER(OLETypedIdxGet);
+  static NAN_SETTER(OLETypedIdxSet);
+  static NAN_METHOD(OLETypedCall);
+  static NAN_METHOD(OLETypedPropGet);
+  static NAN_METHOD(OLETypedPropPut);
+  static NAN_GETTER(OLEAsyncGet); // $async
+  static NAN_METHOD(OLEDispID); // $dispid(name)
+  static NAN_METHOD(OLEInvoke); // $invoke(dispid, flags, args...)
   static NAN_METHOD(Finalize);
 public:
-  V8Dispatch() : finalized(false) {}
+  V8Dispatch();
   ~V8Dispatch() { if(!finalized) Finalize(); }
   ole32core::OCDispatch ocd;
 
-  Local<Value> OLECall(DISPID propID, Nan::NAN_METHOD_ARGS_TYPE info, WORD targetType = DISPATCH_METHOD | DISPATCH_PROPERTYGET);
-  Local<Value> OLECall(DISPID propID, int argc = 0, Local<Value> argv[] = NULL, WORD targetType = DISPATCH_METHOD | DISPATCH_PROPERTYGET);
-  Local<Value> OLEGet(DISPID propID, int argc = 0, Local<Value> argv[] = NULL);
-  bool OLESet(DISPID propID, int argc = 0, Local<Value> argv[] = NULL);
+  // with member (from this object's type), arguments are checked against its declaration and converted to the declared types
+  Local<Value> OLECall(DISPID propID, Nan::NAN_METHOD_ARGS_TYPE info, WORD targetType = DISPATCH_METHOD | DISPATCH_PROPERTYGET, const ole32core::MemberInfo* member = NULL);
+  // with argTypes, undefined arguments are passed as omitted (unless their type is VT_EMPTY) and the others are converted to the given types first
+  Local<Value> OLECall(DISPID propID, int argc = 0, Local<Value> argv[] = NULL, WORD targetType = DISPATCH_METHOD | DISPATCH_PROPERTYGET, const VARTYPE* argTypes = NULL);
+  Local<Value> OLEGet(DISPID propID, int argc = 0, Local<Value> argv[] = NULL, const ole32core::MemberInfo* member = NULL);
+  bool OLESet(DISPID propID, int argc = 0, Local<Value> argv[] = NULL, const ole32core::MemberInfo* member = NULL);
+  // runs [name | DISPID, DISPATCH_* flags, [args]] operations in order, a failed one leaves its Error in its slot
+  Local<Array> OLEBatch(Local<Array> ops);
+  // returns a Promise of the member's result, the call runs on another thread when the object can be reached from there
+  Local<Value> OLECallAsync(Local<String> name, int argc, Local<Value> argv[]);
 
 public:
-  std::wstring m_typeName;
+  // the wrapper objects handed out for members are kept per object, so repeated access doesn't allocate
+  enum EWrapperKind
+  {
+    wk_Member = 0, // V8DispMember
+    wk_IdxProperty, // V8DispIdxProperty
+    wk_Method, // V8DispMethod with DISPATCH_METHOD
+    wk_PropertyGet, // V8DispMethod with DISPATCH_PROPERTYGET
+    wk_PropertyPut, // V8DispMethod with DISPATCH_PROPERTYPUT
+    wk_Async // V8DispAsync
+  };
+  bool findWrapper(Local<Object> thisObject, int kind, DISPID id, Local<Object>& wrapper);
+  void keepWrapper(Local<Object> thisObject, int kind, DISPID id, Local<Object> wrapper);
+  const std::wstring& typeName() const;
+  void setNameCacheMode(int mode, const CLSID* clsid = NULL);
+  // the object lives on apartment's thread (NULL: node's), shared is its global reference if the creator has one
+  void setApartment(ole32core::OCApartment* apartment, ole32core::OCGlobalRef* shared = NULL);
+  ole32core::OCApartment* apartment() const { return m_apartment; }
+
+  // the objects created while a scope is open (results of calls) live where the object called does
+  class ApartmentScope {
+  public:
+    explicit ApartmentScope(ole32core::OCApartment* apartment) : saved(current) { current = apartment; }
+    ~ApartmentScope() { current = saved; }
+    static ole32core::OCApartment* current; // main thread only
+  private:
+    ole32core::OCApartment* saved;
+  };
 
 protected:
+  static Local<FunctionTemplate> typedClass(ole32core::OCTypeMembers* type); // requires a complete, shared table
   static Local<Value> resolveValueChain(Local<Object> thisObject, const char* prop);
   HRESULT interrogateType();
+  bool findMember(Local<String> property, ole32core::MemberRef& result); // requires m_type
+  HRESULT declaredTypes(const ole32core::MemberInfo* member, WORD targetType, int argc, Local<Value> argv[], VARTYPE* argTypes);
+  HRESULT resolveName(Local<String> property, DISPID* pid); // for objects without m_type
+  // ocd.invoke, or a direct vtable call when the member allows it; args are in DISPPARAMS order and stay ours
+  HRESULT invoke(WORD targetType, DISPID propID, VARIANT* pvResult, ole32core::ErrorInfo& errInfo, int argc, VARIANT* args);
+  bool isAgile(); // whether other apartments can get at the object without going through ours
+  HRESULT sharedRef(ole32core::OCGlobalRef** ppRef); // AddRef'ed
+  void attachNameCache();
   void Finalize();
   bool finalized;
-
-  enum EMemberAttr
-  {
-    ma_IsProperty = 1,
-    ma_IsIndexedProperty = 2,
-    ma_IsReadOnly = 4,
-    ma_IsHidden = 8
-  };
-
-  struct MemberInfo
-  {
-    DISPID memberID;
-    int attrs;
-  };
-
-  struct CaseInsensitive : public std::binary_function<std::wstring, std::wstring, bool>
-  {
-    bool operator()(const std::wstring& left, const std::wstring& right) const
-    {
-      return wcsicmp(left.c_str(), right.c_str()) < 0;
-    }
-  };
-
-  typedef std::map<std::wstring, MemberInfo, CaseInsensitive> TMemberMap;
-  bool m_bHasDefaultProp;
-  TMemberMap m_members;
+  bool m_bInterrogated;
+  ole32core::OCTypeMembers* m_type; // shared with every other object of this type, NULL if we have no type information
+  ole32core::OCNameCache* m_names; // GetIDsOfNames results, only used when m_type is NULL
+  int m_nameCacheMode; // ole32core::ENameCacheMode
+  bool m_bHasClsid;
+  CLSID m_clsid;
+  bool m_bVtblChecked;
+  ole32core::OCVtable* m_vtbl; // shared layout of our dual interface, NULL if we can't call through it
+  IUnknown* m_vtblTarget; // ocd.disp queried for m_vtbl->iid
+  int m_agility; // isAgile, -1 until asked
+  ole32core::OCGlobalRef* m_shared; // ocd.disp in the global interface table, for the threads $async calls run on
+  ole32core::OCApartment* m_apartment; // where the object was placed, calls made from node reach it through a proxy
+  typedef std::map<std::pair<DISPID, int>, uint32_t> TWrapperSlots;
+  TWrapperSlots m_wrapperSlots; // index into the array held in InternalField[1]
 };
 
+// converts argv into args in DISPPARAMS (reverse) order, argTypes as for OLECall. Throws and returns false
+// if one can't be, otherwise the caller clears them with ClearArguments. bPin is for calls completed before argv goes away
+bool MarshalArguments(int argc, Local<Value> argv[], const VARTYPE* argTypes, VARIANT* args, bool bPin);
+void ClearArguments(int argc, VARIANT* args);
+
 } // namespace node_win32ole
 
 #endif // __V8DISPATCH_H__
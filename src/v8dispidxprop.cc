@@ -18,7 +18,7 @@ void V8DispIdxProperty::Init(Nan::ADDON_REGISTER_FUNCTION_ARGS_TYPE target)
 {
   Nan::HandleScope scope;
   Local<FunctionTemplate> t = Nan::New<FunctionTemplate>(New);
-  t->InstanceTemplate()->SetInternalFieldCount(1);
+  t->InstanceTemplate()->SetInternalFieldCount(2); // the member, and the V8Dispatch it belongs to
   t->SetClassName(Nan::New("V8DispIdxProperty").ToLocalChecked());
   Nan::SetPrototypeMethod(t, "valueOf", OLEStringValue);
   Nan::SetPrototypeMethod(t, "toString", OLEStringValue);
@@ -37,21 +37,23 @@ NAN_METHOD(V8DispIdxProperty::OLEStringValue)
   Local<Object> thisObject = info.This();
   V8DispIdxProperty *vThis = V8DispIdxProperty::Unwrap<V8DispIdxProperty>(thisObject);
   CHECK_V8(V8DispIdxProperty, vThis);
-  V8Dispatch* vDisp = vThis->getDispatch(thisObject);
+  V8Dispatch* vDisp = vThis->getDispatch();
   CHECK_V8(V8Dispatch, vDisp);
-  std::wstring fullName = (vDisp->m_typeName.empty() ? L"Object" : vDisp->m_typeName) + L"." + vThis->name;
+  std::wstring fullName = (vDisp->typeName().empty() ? L"Object" : vDisp->typeName()) + L"." + vThis->name;
   OLETRACEOUT();
   return info.GetReturnValue().Set(Nan::New((const uint16_t*)fullName.c_str()).ToLocalChecked());
 }
 
-MaybeLocal<Object> V8DispIdxProperty::CreateNew(Handle<Object> dispatch, Handle<String> property, DISPID id)
+MaybeLocal<Object> V8DispIdxProperty::CreateNew(Handle<Object> dispatch, Handle<String> property, DISPID id, const MemberInfo* member)
 {
   DISPFUNCIN();
   Local<FunctionTemplate> localClazz = Nan::New(clazz);
   Local<v8::Value> args[] = { dispatch, property, Nan::New<Int32>(id) };
   int argc = sizeof(args) / sizeof(args[0]); // == 3
-  return Nan::NewInstance(Nan::GetFunction(localClazz).ToLocalChecked(), argc, args);
+  MaybeLocal<Object> mInstance = Nan::NewInstance(Nan::GetFunction(localClazz).ToLocalChecked(), argc, args);
+  if (!mInstance.IsEmpty()) V8DispIdxProperty::Unwrap<V8DispIdxProperty>(mInstance.ToLocalChecked())->member = member;
   DISPFUNCOUT();
+  return mInstance;
 }
 
 NAN_METHOD(V8DispIdxProperty::New)
@@ -80,23 +82,12 @@ NAN_METHOD(V8DispIdxProperty::New)
   CHECK_V8(V8DispMember, v);
   Local<Object> thisObject = info.This();
   v->Wrap(thisObject); // InternalField[0]
-  Nan::ForceSet(thisObject, Nan::New<String>("_dispatch").ToLocalChecked(), info[0]);
+  thisObject->SetInternalField(1, info[0]);
+  v->owner = V8Dispatch::Unwrap<V8Dispatch>(Local<Object>::Cast(info[0]));
   DISPFUNCOUT();
   return info.GetReturnValue().Set(thisObject);
 }
 
-V8Dispatch* V8DispIdxProperty::getDispatch(Local<Object> dispMemberObj)
-{
-  Nan::MaybeLocal<Value> mpropDisp = Nan::GetRealNamedProperty(dispMemberObj, Nan::New<String>("_dispatch").ToLocalChecked());
-  if (mpropDisp.IsEmpty())
-    return NULL;
-  Local<Value> propDisp = mpropDisp.ToLocalChecked();
-  Local<FunctionTemplate> v8DispatchClazz = Nan::New(V8Dispatch::clazz);
-  if (!propDisp->IsObject() || !v8DispatchClazz->HasInstance(propDisp))
-    return NULL;
-  return V8Dispatch::Unwrap<V8Dispatch>(Local<Object>::Cast(propDisp));
-}
-
 NAN_PROPERTY_GETTER(V8DispIdxProperty::OLEGetAttr)
 {
   OLETRACEIN();
@@ -121,12 +112,12 @@ NAN_PROPERTY_GETTER(V8DispIdxProperty::OLEGetAttr)
   // Resolve ourselves as a property reference
   V8DispIdxProperty *vThis = V8DispIdxProperty::Unwrap<V8DispIdxProperty>(thisObject);
   CHECK_V8(V8DispIdxProperty, vThis);
-  V8Dispatch* vDisp = vThis->getDispatch(thisObject);
+  V8Dispatch* vDisp = vThis->getDispatch();
   CHECK_V8(V8Dispatch, vDisp);
 
   Handle<Value> argv[] = { property };
   int argc = sizeof(argv) / sizeof(argv[0]); // == 1
-  Local<Value> vResult = vDisp->OLEGet(vThis->memberId, argc, argv);
+  Local<Value> vResult = vDisp->OLEGet(vThis->memberId, argc, argv, vThis->member);
   if (!vResult->IsUndefined())
   {
     return info.GetReturnValue().Set(vResult);
@@ -162,12 +153,12 @@ NAN_PROPERTY_SETTER(V8DispIdxProperty::OLESetAttr)
   // Resolve ourselves as a property reference
   V8DispIdxProperty *vThis = V8DispIdxProperty::Unwrap<V8DispIdxProperty>(thisObject);
   CHECK_V8(V8DispIdxProperty, vThis);
-  V8Dispatch* vDisp = vThis->getDispatch(thisObject);
+  V8Dispatch* vDisp = vThis->getDispatch();
   CHECK_V8(V8Dispatch, vDisp);
 
   Handle<Value> argv[] = { property, value };
   int argc = sizeof(argv) / sizeof(argv[0]); // == 2
-  bool bResult = vDisp->OLESet(vThis->memberId, argc, argv);
+  bool bResult = vDisp->OLESet(vThis->memberId, argc, argv, vThis->member);
   if (bResult) return info.GetReturnValue().Set(true);
 
   OLETRACEOUT();
@@ -186,12 +177,12 @@ NAN_INDEX_GETTER(V8DispIdxProperty::OLEGetIdxAttr)
   // Resolve ourselves as an indexed property reference
   V8DispIdxProperty *vThis = V8DispIdxProperty::Unwrap<V8DispIdxProperty>(thisObject);
   CHECK_V8(V8DispMember, vThis);
-  V8Dispatch* vDisp = vThis->getDispatch(thisObject);
+  V8Dispatch* vDisp = vThis->getDispatch();
   CHECK_V8(V8Dispatch, vDisp);
 
   Handle<Value> argv[] = { Nan::New(index) };
   int argc = sizeof(argv) / sizeof(argv[0]); // == 1
-  Local<Value> vResult = vDisp->OLEGet(vThis->memberId, argc, argv);
+  Local<Value> vResult = vDisp->OLEGet(vThis->memberId, argc, argv, vThis->member);
   if (!vResult->IsUndefined())
   {
     return info.GetReturnValue().Set(vResult);
@@ -213,12 +204,12 @@ NAN_INDEX_SETTER(V8DispIdxProperty::OLESetIdxAttr)
   // Resolve ourselves as an indexed property reference
   V8DispIdxProperty *vThis = V8DispIdxProperty::Unwrap<V8DispIdxProperty>(thisObject);
   CHECK_V8(V8DispMember, vThis);
-  V8Dispatch* vDisp = vThis->getDispatch(thisObject);
+  V8Dispatch* vDisp = vThis->getDispatch();
   CHECK_V8(V8Dispatch, vDisp);
 
   Handle<Value> argv[] = { Nan::New(index), value };
   int argc = sizeof(argv) / sizeof(argv[0]); // == 2
-  bool bResult = vDisp->OLESet(vThis->memberId, argc, argv);
+  bool bResult = vDisp->OLESet(vThis->memberId, argc, argv, vThis->member);
   if (bResult)
   {
     return info.GetReturnValue().Set(true);
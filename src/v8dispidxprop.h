@@ -5,6 +5,7 @@
 #include <nan.h>
 #include "node_win32ole.h"
 #include "ole32core.h"
+#include "oletypeinfo.h"
 
 namespace node_win32ole {
 
@@ -16,18 +17,20 @@ public:
   static Nan::Persistent<FunctionTemplate> clazz;
   static void Init(Nan::ADDON_REGISTER_FUNCTION_ARGS_TYPE target);
   static NAN_METHOD(OLEStringValue);
-  static MaybeLocal<Object> CreateNew(Handle<Object> dispatch, Handle<String> property, DISPID id); // *** private
+  static MaybeLocal<Object> CreateNew(Handle<Object> dispatch, Handle<String> property, DISPID id, const ole32core::MemberInfo* member = NULL); // *** private
   static NAN_METHOD(New);
   static NAN_PROPERTY_GETTER(OLEGetAttr);
   static NAN_PROPERTY_SETTER(OLESetAttr);
   static NAN_INDEX_GETTER(OLEGetIdxAttr);
   static NAN_INDEX_SETTER(OLESetIdxAttr);
 public:
-  inline V8DispIdxProperty(const wchar_t* n, DISPID id) : memberId(id),name(n) {}
+  inline V8DispIdxProperty(const wchar_t* n, DISPID id) : owner(NULL), memberId(id), name(n), member(NULL) {}
 protected:
-  V8Dispatch* getDispatch(Local<Object> dispMemberObj);
+  V8Dispatch* getDispatch() const { return owner; }
+  V8Dispatch* owner; // kept alive by InternalField[1]
   DISPID memberId;
   std::wstring name;
+  const ole32core::MemberInfo* member; // the declaration of memberId in the owner's type, if it has one
 };
 
 } // namespace node_win32ole
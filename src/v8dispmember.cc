@@ -18,7 +18,7 @@ void V8DispMember::Init(Nan::ADDON_REGISTER_FUNCTION_ARGS_TYPE target)
 {
   Nan::HandleScope scope;
   Local<FunctionTemplate> t = Nan::New<FunctionTemplate>(New);
-  t->InstanceTemplate()->SetInternalFieldCount(1);
+  t->InstanceTemplate()->SetInternalFieldCount(2); // the member, and the V8Dispatch it belongs to
   t->SetClassName(Nan::New("V8DispMember").ToLocalChecked());
   Nan::SetPrototypeMethod(t, "valueOf", OLEPrimitiveValue);
   Nan::SetPrototypeMethod(t, "toString", OLEStringValue);
@@ -42,7 +42,7 @@ Local<Value> V8DispMember::resolveValue(Local<Object> thisObject)
 {
   V8DispMember *vThis = V8DispMember::Unwrap<V8DispMember>(thisObject);
   CHECK_V8_UNDEFINED(V8DispMember, vThis);
-  V8Dispatch* vDisp = vThis->getDispatch(thisObject);
+  V8Dispatch* vDisp = vThis->getDispatch();
   if (!vDisp) return Nan::Undefined();
   return vDisp->OLEGet(vThis->memberId);
 }
@@ -127,23 +127,12 @@ NAN_METHOD(V8DispMember::New)
   CHECK_V8(V8DispMember, v);
   Local<Object> thisObject = info.This();
   v->Wrap(thisObject); // InternalField[0]
-  Nan::ForceSet(thisObject, Nan::New<String>("_dispatch").ToLocalChecked(), info[0]);
+  thisObject->SetInternalField(1, info[0]);
+  v->owner = V8Dispatch::Unwrap<V8Dispatch>(Local<Object>::Cast(info[0]));
   DISPFUNCOUT();
   return info.GetReturnValue().Set(thisObject);
 }
 
-V8Dispatch* V8DispMember::getDispatch(Local<Object> dispMemberObj)
-{
-  Nan::MaybeLocal<Value> mpropDisp = Nan::GetRealNamedProperty(dispMemberObj, Nan::New<String>("_dispatch").ToLocalChecked());
-  if (mpropDisp.IsEmpty())
-    return NULL;
-  Local<Value> propDisp = mpropDisp.ToLocalChecked();
-  Local<FunctionTemplate> v8DispatchClazz = Nan::New(V8Dispatch::clazz);
-  if (!propDisp->IsObject() || !v8DispatchClazz->HasInstance(propDisp))
-    return NULL;
-  return V8Dispatch::Unwrap<V8Dispatch>(Local<Object>::Cast(propDisp));
-}
-
 NAN_METHOD(V8DispMember::OLECall)
 {
   OLETRACEIN();
@@ -151,7 +140,7 @@ NAN_METHOD(V8DispMember::OLECall)
   Local<Object> thisObject = info.This();
   V8DispMember *vThis = V8DispMember::Unwrap<V8DispMember>(thisObject);
   CHECK_V8(V8DispMember, vThis);
-  V8Dispatch* vDisp = vThis->getDispatch(thisObject);
+  V8Dispatch* vDisp = vThis->getDispatch();
   CHECK_V8(V8Dispatch, vDisp);
   Local<Value> vResult = vDisp->OLECall(vThis->memberId, info);
   if (!vResult->IsUndefined())
@@ -235,7 +224,7 @@ NAN_PROPERTY_SETTER(V8DispMember::OLESetAttr)
   // Resolve ourselves as a property reference
   V8DispMember *vThis = V8DispMember::Unwrap<V8DispMember>(thisObject);
   CHECK_V8(V8DispMember, vThis);
-  V8Dispatch* vDisp = vThis->getDispatch(thisObject);
+  V8Dispatch* vDisp = vThis->getDispatch();
   CHECK_V8(V8Dispatch, vDisp);
   Local<Value> vResult = vDisp->OLEGet(vThis->memberId);
   if (vResult->IsUndefined()) return;
@@ -265,7 +254,7 @@ NAN_INDEX_GETTER(V8DispMember::OLEGetIdxAttr)
   // Resolve ourselves as an indexed property reference
   V8DispMember *vThis = V8DispMember::Unwrap<V8DispMember>(thisObject);
   CHECK_V8(V8DispMember, vThis);
-  V8Dispatch* vDisp = vThis->getDispatch(thisObject);
+  V8Dispatch* vDisp = vThis->getDispatch();
   CHECK_V8(V8Dispatch, vDisp);
 
   Handle<Value> argv[] = { Nan::New(index) };
@@ -292,7 +281,7 @@ NAN_INDEX_SETTER(V8DispMember::OLESetIdxAttr)
   // Resolve ourselves as an indexed property reference
   V8DispMember *vThis = V8DispMember::Unwrap<V8DispMember>(thisObject);
   CHECK_V8(V8DispMember, vThis);
-  V8Dispatch* vDisp = vThis->getDispatch(thisObject);
+  V8Dispatch* vDisp = vThis->getDispatch();
   CHECK_V8(V8Dispatch, vDisp);
 
   Handle<Value> argv[] = { Nan::New(index), value };
@@ -27,11 +27,12 @@ public:
   static NAN_INDEX_GETTER(OLEGetIdxAttr);
   static NAN_INDEX_SETTER(OLESetIdxAttr);
 public:
-  inline V8DispMember(DISPID id) : memberId(id) {}
+  inline V8DispMember(DISPID id) : owner(NULL), memberId(id) {}
 protected:
   static Local<Value> resolveValue(Local<Object> thisObject);
   static Local<Value> resolveValueChain(Local<Object> thisObject, const char* prop);
-  V8Dispatch* getDispatch(Local<Object> dispMemberObj);
+  V8Dispatch* getDispatch() const { return owner; }
+  V8Dispatch* owner; // kept alive by InternalField[1]
   DISPID memberId;
 };
 
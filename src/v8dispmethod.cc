@@ -18,7 +18,7 @@ void V8DispMethod::Init(Nan::ADDON_REGISTER_FUNCTION_ARGS_TYPE target)
 {
   Nan::HandleScope scope;
   Local<FunctionTemplate> t = Nan::New<FunctionTemplate>(New);
-  t->InstanceTemplate()->SetInternalFieldCount(1);
+  t->InstanceTemplate()->SetInternalFieldCount(2); // the member, and the V8Dispatch it belongs to
   t->SetClassName(Nan::New("V8DispMethod").ToLocalChecked());
   Nan::SetPrototypeMethod(t, "valueOf", OLEStringValue);
   Nan::SetPrototypeMethod(t, "toString", OLEStringValue);
@@ -36,21 +36,23 @@ NAN_METHOD(V8DispMethod::OLEStringValue)
   Local<Object> thisObject = info.This();
   V8DispMethod *vThis = V8DispMethod::Unwrap<V8DispMethod>(thisObject);
   CHECK_V8(V8DispMethod, vThis);
-  V8Dispatch* vDisp = vThis->getDispatch(thisObject);
+  V8Dispatch* vDisp = vThis->getDispatch();
   CHECK_V8(V8Dispatch, vDisp);
-  std::wstring fullName = (vDisp->m_typeName.empty() ? L"Object" : vDisp->m_typeName) + L"." + vThis->name;
+  std::wstring fullName = (vDisp->typeName().empty() ? L"Object" : vDisp->typeName()) + L"." + vThis->name;
   OLETRACEOUT();
   return info.GetReturnValue().Set(Nan::New((const uint16_t*)fullName.c_str()).ToLocalChecked());
 }
 
-MaybeLocal<Object> V8DispMethod::CreateNew(Handle<Object> dispatch, WORD targetType, Handle<String> property, DISPID id) // *** private
+MaybeLocal<Object> V8DispMethod::CreateNew(Handle<Object> dispatch, WORD targetType, Handle<String> property, DISPID id, const MemberInfo* member) // *** private
 {
   DISPFUNCIN();
   Local<FunctionTemplate> localClazz = Nan::New(clazz);
   Local<v8::Value> args[] = { dispatch, Nan::New<Int32>(targetType), property, Nan::New<Int32>(id) };
   int argc = sizeof(args) / sizeof(args[0]); // == 4
-  return Nan::NewInstance(Nan::GetFunction(localClazz).ToLocalChecked(), argc, args);
+  MaybeLocal<Object> mInstance = Nan::NewInstance(Nan::GetFunction(localClazz).ToLocalChecked(), argc, args);
+  if (!mInstance.IsEmpty()) V8DispMethod::Unwrap<V8DispMethod>(mInstance.ToLocalChecked())->member = member;
   DISPFUNCOUT();
+  return mInstance;
 }
 
 NAN_METHOD(V8DispMethod::New)
@@ -81,23 +83,12 @@ NAN_METHOD(V8DispMethod::New)
   CHECK_V8(V8DispMember, v);
   Local<Object> thisObject = info.This();
   v->Wrap(thisObject); // InternalField[0]
-  Nan::ForceSet(thisObject, Nan::New<String>("_dispatch").ToLocalChecked(), info[0]);
+  thisObject->SetInternalField(1, info[0]);
+  v->owner = V8Dispatch::Unwrap<V8Dispatch>(Local<Object>::Cast(info[0]));
   DISPFUNCOUT();
   return info.GetReturnValue().Set(thisObject);
 }
 
-V8Dispatch* V8DispMethod::getDispatch(Local<Object> dispMemberObj)
-{
-  Nan::MaybeLocal<Value> mpropDisp = Nan::GetRealNamedProperty(dispMemberObj, Nan::New<String>("_dispatch").ToLocalChecked());
-  if (mpropDisp.IsEmpty())
-    return NULL;
-  Local<Value> propDisp = mpropDisp.ToLocalChecked();
-  Local<FunctionTemplate> v8DispatchClazz = Nan::New(V8Dispatch::clazz);
-  if (!propDisp->IsObject() || !v8DispatchClazz->HasInstance(propDisp))
-    return NULL;
-  return V8Dispatch::Unwrap<V8Dispatch>(Local<Object>::Cast(propDisp));
-}
-
 NAN_METHOD(V8DispMethod::OLECall)
 {
   OLETRACEIN();
@@ -105,9 +96,9 @@ NAN_METHOD(V8DispMethod::OLECall)
   Local<Object> thisObject = info.This();
   V8DispMethod *vThis = V8DispMethod::Unwrap<V8DispMethod>(thisObject);
   CHECK_V8(V8DispMember, vThis);
-  V8Dispatch* vDisp = vThis->getDispatch(thisObject);
+  V8Dispatch* vDisp = vThis->getDispatch();
   CHECK_V8(V8Dispatch, vDisp);
-  Local<Value> vResult = vDisp->OLECall(vThis->memberId, info, vThis->targetType);
+  Local<Value> vResult = vDisp->OLECall(vThis->memberId, info, vThis->targetType, vThis->member);
   if (!vResult->IsUndefined())
   {
     return info.GetReturnValue().Set(vResult);
@@ -5,6 +5,7 @@
 #include <nan.h>
 #include "node_win32ole.h"
 #include "ole32core.h"
+#include "oletypeinfo.h"
 
 namespace node_win32ole {
 
@@ -16,16 +17,18 @@ public:
   static Nan::Persistent<FunctionTemplate> clazz;
   static void Init(Nan::ADDON_REGISTER_FUNCTION_ARGS_TYPE target);
   static NAN_METHOD(OLEStringValue);
-  static MaybeLocal<Object> CreateNew(Handle<Object> dispatch, WORD targetType, Handle<String> property, DISPID id); // *** private
+  static MaybeLocal<Object> CreateNew(Handle<Object> dispatch, WORD targetType, Handle<String> property, DISPID id, const ole32core::MemberInfo* member = NULL); // *** private
   static NAN_METHOD(New);
   static NAN_METHOD(OLECall);
 public:
-  inline V8DispMethod(WORD type, const wchar_t* n, DISPID id) :targetType(type), name(n), memberId(id) {}
+  inline V8DispMethod(WORD type, const wchar_t* n, DISPID id) :owner(NULL), targetType(type), name(n), memberId(id), member(NULL) {}
 protected:
-  V8Dispatch* getDispatch(Local<Object> dispMethodObj);
+  V8Dispatch* getDispatch() const { return owner; }
+  V8Dispatch* owner; // kept alive by InternalField[1]
   WORD targetType;
   std::wstring name;
   DISPID memberId;
+  const ole32core::MemberInfo* member; // the declaration of memberId in the owner's type, if it has one
 };
 
 } // namespace node_win32ole
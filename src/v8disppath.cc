@@ -0,0 +1,129 @@
+/*
+  v8disppath.cc
+*/
+
+#include "v8disppath.h"
+#include <node.h>
+#include <nan.h>
+#include "v8dispatch.h"
+#include "v8variant.h"
+
+using namespace v8;
+using namespace ole32core;
+
+namespace node_win32ole {
+
+Nan::Persistent<FunctionTemplate> V8DispPath::clazz;
+
+void V8DispPath::Init(Nan::ADDON_REGISTER_FUNCTION_ARGS_TYPE target)
+{
+  Nan::HandleScope scope;
+  Local<FunctionTemplate> t = Nan::New<FunctionTemplate>(New);
+  t->InstanceTemplate()->SetInternalFieldCount(1);
+  t->SetClassName(Nan::New("V8DispPath").ToLocalChecked());
+  Nan::SetPrototypeMethod(t, "valueOf", OLEStringValue);
+  Nan::SetPrototypeMethod(t, "toString", OLEStringValue);
+  Nan::SetPrototypeMethod(t, "toLocaleString", OLEStringValue);
+
+  Local<ObjectTemplate> instancetpl = t->InstanceTemplate();
+  Nan::SetCallAsFunctionHandler(instancetpl, OLECall);
+  Nan::Set(target, Nan::New("V8DispPath").ToLocalChecked(), t->GetFunction());
+  clazz.Reset(t);
+}
+
+NAN_METHOD(V8DispPath::OLEStringValue)
+{
+  OLETRACEIN();
+  V8DispPath *vThis = V8DispPath::Unwrap<V8DispPath>(info.This());
+  CHECK_V8(V8DispPath, vThis);
+  OLETRACEOUT();
+  return info.GetReturnValue().Set(Nan::New((const uint16_t*)vThis->source.c_str()).ToLocalChecked());
+}
+
+MaybeLocal<Object> V8DispPath::CreateNew(Handle<Object> root, Handle<String> path) // *** private
+{
+  DISPFUNCIN();
+  Local<FunctionTemplate> localClazz = Nan::New(clazz);
+  Local<v8::Value> args[] = { root, path };
+  int argc = sizeof(args) / sizeof(args[0]); // == 2
+  return Nan::NewInstance(Nan::GetFunction(localClazz).ToLocalChecked(), argc, args);
+  DISPFUNCOUT();
+}
+
+NAN_METHOD(V8DispPath::New)
+{
+  DISPFUNCIN();
+  if(!info.IsConstructCall())
+    return Nan::ThrowTypeError("Use the new operator to create new V8DispPath objects");
+  Local<FunctionTemplate> v8DispatchClazz = Nan::New(V8Dispatch::clazz);
+  if (info.Length() != 2 || !info[0]->IsObject() || !v8DispatchClazz->HasInstance(info[0]))
+    return Nan::ThrowTypeError("Must be constructed with (V8Dispatch, path)");
+  if (!info[1]->IsString())
+    return Nan::ThrowTypeError("Second argument must be a String");
+  V8Dispatch* vRoot = V8Dispatch::Unwrap<V8Dispatch>(Local<Object>::Cast(info[0]));
+  CHECK_V8(V8Dispatch, vRoot);
+  String::Value vPath(info[1]);
+  std::wstring source((const wchar_t*)*vPath, vPath.length());
+
+  // the members are looked up in the root's type now, objects of that type are what the path is run on
+  OCMemberPath* path;
+  HRESULT hr = OCMemberPath::compile(vRoot->ocd.getTypeInfo(), source.c_str(), &path);
+  if (hr == E_INVALIDARG)
+    return Nan::ThrowSyntaxError("member path must look like Name(?, ?).Name.Name");
+  if (FAILED(hr)) return Nan::ThrowError(NewOleException(hr));
+  V8DispPath *v = new V8DispPath(); // must catch exception
+  CHECK_V8(V8DispPath, v);
+  v->path = path;
+  v->source = source;
+  Local<Object> thisObject = info.This();
+  v->Wrap(thisObject); // InternalField[0]
+  DISPFUNCOUT();
+  return info.GetReturnValue().Set(thisObject);
+}
+
+NAN_METHOD(V8DispPath::OLECall)
+{
+  OLETRACEIN();
+  OLETRACEARGS();
+  V8DispPath *vThis = V8DispPath::Unwrap<V8DispPath>(info.This());
+  CHECK_V8(V8DispPath, vThis);
+  Local<FunctionTemplate> v8DispatchClazz = Nan::New(V8Dispatch::clazz);
+  if (info.Length() < 1 || !info[0]->IsObject() || !v8DispatchClazz->HasInstance(info[0]))
+    return Nan::ThrowTypeError("Argument 1 is not a V8Dispatch object");
+  V8Dispatch* vDisp = V8Dispatch::Unwrap<V8Dispatch>(Local<Object>::Cast(info[0]));
+  CHECK_V8(V8Dispatch, vDisp);
+  int argc = (int)vThis->path->argCount();
+  bool bPut = info.Length() - 1 == argc + 1;
+  if (!bPut && info.Length() - 1 != argc)
+    return Nan::ThrowTypeError(("expects " + to_s(argc) + " arguments (one more to assign)").c_str());
+
+  int count = argc + (bPut ? 1 : 0);
+  Local<Value>* argv = (Local<Value>*)alloca(sizeof(Local<Value>) * (count ? count : 1));
+  VARTYPE* argTypes = (VARTYPE*)alloca(sizeof(VARTYPE) * (count ? count : 1));
+  for (int i = 0; i < count; ++i)
+  {
+    *(new(argv + i) Local<Value>) = info[1 + i];
+    argTypes[i] = i < argc ? VT_VARIANT : VT_EMPTY; // an undefined ? is omitted, the value assigned is passed as it is
+  }
+  VARIANT* args = (VARIANT*)alloca(sizeof(VARIANT) * (count ? count : 1));
+  bool bOk = MarshalArguments(count, argv, argTypes, args, true);
+  for (int i = 0; i < count; ++i) (argv + i)->~Local<Value>();
+  if (!bOk) return;
+  ErrorInfo errInfo;
+  errInfo.wCode = 0;
+  errInfo.scode = 0;
+  errInfo.dwHelpContext = 0;
+  VARIANT result;
+  HRESULT hr = vThis->path->run(vDisp->ocd.disp, vDisp->ocd.getTypeInfo(), args, bPut, &result, errInfo);
+  ClearArguments(count, args);
+  if (FAILED(hr)) return Nan::ThrowError(NewOleException(hr, errInfo));
+  if (bPut) return;
+  // what the path ends on lives where its root does
+  V8Dispatch::ApartmentScope scope(vDisp->apartment());
+  Local<Value> vResult = V8Variant::ResultToValue(result);
+  VariantClear(&result);
+  OLETRACEOUT();
+  return info.GetReturnValue().Set(vResult);
+}
+
+} // namespace node_win32ole
@@ -0,0 +1,32 @@
+#ifndef __V8DISPPATH_H__
+#define __V8DISPPATH_H__
+
+#include <node.h>
+#include <nan.h>
+#include "node_win32ole.h"
+#include "ole32core.h"
+#include "olememberpath.h"
+
+namespace node_win32ole {
+
+// The function win32ole.compile returns: called as fn(dispatch, args...) it walks its member path
+// from dispatch and returns the last value, given one more argument it assigns that to the last member
+class V8DispPath : public node::ObjectWrap {
+public:
+  static Nan::Persistent<FunctionTemplate> clazz;
+  static void Init(Nan::ADDON_REGISTER_FUNCTION_ARGS_TYPE target);
+  static NAN_METHOD(OLEStringValue);
+  static MaybeLocal<Object> CreateNew(Handle<Object> root, Handle<String> path); // *** private
+  static NAN_METHOD(New);
+  static NAN_METHOD(OLECall);
+public:
+  inline V8DispPath() : path(NULL) {}
+  ~V8DispPath() { if (path) path->Release(); }
+protected:
+  ole32core::OCMemberPath* path;
+  std::wstring source;
+};
+
+} // namespace node_win32ole
+
+#endif // __V8DISPPATH_H__
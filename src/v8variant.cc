@@ -5,8 +5,16 @@
 #include "v8variant.h"
 #include "v8dispatch.h"
 #include "v8dispmember.h"
+#include "oledate.h"
 #include <node.h>
 #include <nan.h>
+#include <list>
+#include <map>
+#include <vector>
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define NARROW_SSE2
+#endif
 
 using namespace v8;
 using namespace ole32core;
@@ -115,55 +123,414 @@ void V8Variant::Init(Nan::ADDON_REGISTER_FUNCTION_ARGS_TYPE target)
   clazz.Reset(t);
 }
 
-OCVariant *V8Variant::ValueToVariant(Handle<Value> v)
+namespace {
+
+// Short strings passed by value (mostly literals like field names) are kept as BSTRs, most
+// recently used first, and lent to the callee instead of allocating and freeing one per call.
+// Evicted BSTRs may still be lent out, they are only freed once no lent string is outstanding.
+struct InternedString
+{
+  Nan::Persistent<String>* name;
+  BSTR bstr;
+};
+
+typedef std::list<InternedString> TInternedList;
+typedef std::multimap<int, TInternedList::iterator> TInternedIndex;
+
+const int MAX_INTERNED_LENGTH = 64;
+const WORD LENT_MARK = 0x4c4e; // in wReserved1 of the VARIANTs holding a lent BSTR
+
+unsigned stringCacheSize = 0;
+TInternedList internedStrings;
+TInternedIndex internedIndex;
+std::list<BSTR> retiredStrings;
+size_t lentStrings = 0;
+V8Variant::StringCacheStats stringCacheStats = { 0, 0, 0 };
+OCLocalTime localTime; // OLE dates are local, converted on node's thread only
+
+void EvictInternedString()
+{
+  InternedString& entry = internedStrings.back();
+  int hash = Nan::New(*entry.name)->GetIdentityHash();
+  std::pair<TInternedIndex::iterator, TInternedIndex::iterator> range = internedIndex.equal_range(hash);
+  for (TInternedIndex::iterator it = range.first; it != range.second; ++it)
+  {
+    if (it->second->bstr == entry.bstr)
+    {
+      internedIndex.erase(it);
+      break;
+    }
+  }
+  if (lentStrings) retiredStrings.push_back(entry.bstr);
+  else ::SysFreeString(entry.bstr);
+  entry.name->Reset();
+  delete entry.name;
+  internedStrings.pop_back();
+  stringCacheStats.entries = internedStrings.size();
+}
+
+// a BSTR owned by the cache, NULL if s is too long or we're out of memory
+BSTR LendString(Local<String> s)
+{
+  int len = s->Length();
+  if (!stringCacheSize || len > MAX_INTERNED_LENGTH) return NULL;
+  int hash = s->GetIdentityHash();
+  std::pair<TInternedIndex::iterator, TInternedIndex::iterator> range = internedIndex.equal_range(hash);
+  for (TInternedIndex::iterator it = range.first; it != range.second; ++it)
+  {
+    TInternedList::iterator entry = it->second;
+    if (!Nan::New(*entry->name)->StrictEquals(s)) continue;
+    internedStrings.splice(internedStrings.begin(), internedStrings, entry);
+    ++stringCacheStats.hits;
+    ++lentStrings;
+    return entry->bstr;
+  }
+  ++stringCacheStats.misses;
+  BSTR bstr = ::SysAllocStringLen(NULL, (UINT)len);
+  if (!bstr) return NULL;
+  s->Write((uint16_t*)bstr, 0, len, String::NO_NULL_TERMINATION);
+  while (internedStrings.size() >= stringCacheSize) EvictInternedString();
+  InternedString entry = { new Nan::Persistent<String>(s), bstr };
+  internedStrings.push_front(entry);
+  internedIndex.insert(TInternedIndex::value_type(hash, internedStrings.begin()));
+  stringCacheStats.entries = internedStrings.size();
+  ++lentStrings;
+  return bstr;
+}
+
+} // namespace
+
+void V8Variant::SetStringCacheSize(unsigned size)
+{
+  stringCacheSize = size;
+  while (internedStrings.size() > stringCacheSize) EvictInternedString();
+}
+
+void V8Variant::GetStringCacheStats(StringCacheStats& stats)
+{
+  stats = stringCacheStats;
+}
+
+void V8Variant::ClearArgument(VARIANT& v)
+{
+  if ((v.vt & VT_ARRAY) && v.wReserved1 == LENT_MARK)
+  {
+    SAFEARRAY* psa = v.parray;
+    SafeArrayUnlock(psa);
+    psa->pvData = NULL; // the elements are the JS view's memory
+    SafeArrayDestroyDescriptor(psa);
+    VariantInit(&v);
+    return;
+  }
+  if (v.vt == VT_BSTR && v.wReserved1 == LENT_MARK)
+  {
+    VariantInit(&v);
+    if (!--lentStrings)
+    {
+      for (std::list<BSTR>::iterator it = retiredStrings.begin(); it != retiredStrings.end(); ++it) ::SysFreeString(*it);
+      retiredStrings.clear();
+    }
+    return;
+  }
+  VariantClear(&v);
+}
+
+// writes the characters straight into a new BSTR, which the VARIANT then owns
+static bool StringToVariant(Local<String> s, VARIANT& result)
+{
+  int len = s->Length();
+  BSTR bstr = ::SysAllocStringLen(NULL, (UINT)len);
+  if (!bstr)
+  {
+    Nan::ThrowError(NewOleException(E_OUTOFMEMORY));
+    return false;
+  }
+  s->Write((uint16_t*)bstr, 0, len, String::NO_NULL_TERMINATION);
+  result.vt = VT_BSTR;
+  result.bstrVal = bstr;
+  return true;
+}
+
+// the SAFEARRAY element type of a TypedArray, bytes for Buffers, DataViews and the like
+static VARTYPE ViewElementType(Local<ArrayBufferView> view, size_t* cbElement)
+{
+  VARTYPE vt = VT_UI1;
+  *cbElement = 1;
+  if (view->IsFloat64Array()) { vt = VT_R8; *cbElement = 8; }
+  else if (view->IsFloat32Array()) { vt = VT_R4; *cbElement = 4; }
+  else if (view->IsInt32Array()) { vt = VT_I4; *cbElement = 4; }
+  else if (view->IsUint32Array()) { vt = VT_UI4; *cbElement = 4; }
+  else if (view->IsInt16Array()) { vt = VT_I2; *cbElement = 2; }
+  else if (view->IsUint16Array()) { vt = VT_UI2; *cbElement = 2; }
+  else if (view->IsInt8Array()) vt = VT_I1;
+  return vt;
+}
+
+// A one-dimensional SAFEARRAY of the view's elements. With bPin it is only a descriptor over the
+// view's own memory, for a call made while the caller holds the view: locked and fixed in size so
+// the callee can't free or resize it, and dropped by ClearArgument without touching the elements.
+static bool ViewToVariant(Local<ArrayBufferView> view, VARIANT& result, bool bPin)
+{
+  size_t cbElement;
+  VARTYPE vt = ViewElementType(view, &cbElement);
+  Local<ArrayBuffer> buffer = view->Buffer(); // moves small arrays off the V8 heap, their memory stays put from now on
+  BYTE* data = (BYTE*)buffer->GetContents().Data() + view->ByteOffset();
+  ULONG count = (ULONG)(view->ByteLength() / cbElement);
+  SAFEARRAY* psa = NULL;
+  HRESULT hr = S_OK;
+  if (bPin)
+  {
+    hr = SafeArrayAllocDescriptorEx(vt, 1, &psa);
+    if (SUCCEEDED(hr))
+    {
+      psa->rgsabound[0].lLbound = 0;
+      psa->rgsabound[0].cElements = count;
+      psa->fFeatures |= FADF_FIXEDSIZE;
+      psa->pvData = data;
+      SafeArrayLock(psa);
+    }
+  } else {
+    psa = SafeArrayCreateVector(vt, 0, count);
+    if (!psa) hr = E_OUTOFMEMORY;
+    else if (count) memcpy(psa->pvData, data, count * cbElement);
+  }
+  if (FAILED(hr))
+  {
+    Nan::ThrowError(NewOleException(hr));
+    return false;
+  }
+  result.vt = VT_ARRAY | vt;
+  result.parray = psa;
+  if (bPin) result.wReserved1 = LENT_MARK;
+  return true;
+}
+
+// the type every element of a SAFEARRAY made from a JS array gets, given the one so far and the next element
+static VARTYPE MergeElementType(VARTYPE vt, Local<Value> e)
+{
+  VARTYPE next = e->IsInt32() ? VT_I4 : e->IsNumber() ? VT_R8 : e->IsString() ? VT_BSTR : VT_VARIANT;
+  if (vt == VT_EMPTY || vt == next) return next;
+  if ((vt == VT_I4 && next == VT_R8) || (vt == VT_R8 && next == VT_I4)) return VT_R8;
+  return VT_VARIANT;
+}
+
+// checks that a nest of arrays has the lengths in dims at every level (outermost first) and finds its element type,
+// false as well when a getter throws
+static bool ScanArray(Local<Array> a, const std::vector<unsigned>& dims, unsigned dim, VARTYPE& vt)
+{
+  if (a->Length() != dims[dim]) return false;
+  bool bLeaves = dim + 1 == dims.size();
+  for (uint32_t idx = 0; idx < dims[dim]; ++idx)
+  {
+    Local<Value> e;
+    if (!Nan::Get(a, idx).ToLocal(&e)) return false;
+    if (!bLeaves)
+    {
+      if (!e->IsArray() || !ScanArray(Local<Array>::Cast(e), dims, dim + 1, vt)) return false;
+    } else {
+      if (e->IsArray()) return false; // deeper than its siblings
+      vt = MergeElementType(vt, e);
+    }
+  }
+  return true;
+}
+
+// getters may change the array between ScanArray and the fill, the elements are checked again as they are written
+static bool ArrayChanged()
+{
+  Nan::ThrowTypeError("The array changed while it was being converted");
+  return false;
+}
+
+struct I4Writer
+{
+  static bool write(Local<Value> e, BYTE* p)
+  {
+    if (!e->IsInt32()) return ArrayChanged();
+    *reinterpret_cast<LONG*>(p) = (LONG)Nan::To<int32_t>(e).FromJust();
+    return true;
+  }
+};
+
+struct R8Writer
+{
+  static bool write(Local<Value> e, BYTE* p)
+  {
+    if (!e->IsNumber()) return ArrayChanged();
+    *reinterpret_cast<DOUBLE*>(p) = Nan::To<double>(e).FromJust();
+    return true;
+  }
+};
+
+struct BstrWriter
+{
+  static bool write(Local<Value> e, BYTE* p)
+  {
+    if (!e->IsString()) return ArrayChanged();
+    VARIANT v;
+    VariantInit(&v);
+    if (!StringToVariant(Local<String>::Cast(e), v)) return false;
+    *reinterpret_cast<BSTR*>(p) = v.bstrVal; // the array owns it now
+    return true;
+  }
+};
+
+struct VariantWriter
+{
+  static bool write(Local<Value> e, BYTE* p) { return V8Variant::ValueToVariant(e, *reinterpret_cast<VARIANT*>(p)); }
+};
+
+// stores the elements of a nest of arrays where SAFEARRAY keeps them, leftmost index varying fastest
+template <class Writer>
+static bool FillSafeArray(Local<Array> a, const std::vector<unsigned>& dims, const size_t* strides, unsigned dim,
+  BYTE* data, size_t offset, unsigned cbElements)
+{
+  bool bLeaves = dim + 1 == dims.size();
+  for (uint32_t idx = 0; idx < dims[dim]; ++idx)
+  {
+    Local<Value> e;
+    if (!Nan::Get(a, idx).ToLocal(&e)) return false; // a getter threw
+    size_t at = offset + idx * strides[dim];
+    if (bLeaves)
+    {
+      if (!Writer::write(e, data + at * cbElements)) return false;
+    }
+    else if (!e->IsArray() || Local<Array>::Cast(e)->Length() != dims[dim + 1]) return ArrayChanged();
+    else if (!FillSafeArray<Writer>(Local<Array>::Cast(e), dims, strides, dim + 1, data, at, cbElements)) return false;
+  }
+  return true;
+}
+
+// Rectangular nests of arrays become one SAFEARRAY of as many dimensions, typed VT_I4, VT_R8 or VT_BSTR when
+// every element agrees and VT_VARIANT otherwise. Ragged ones become arrays of arrays (VT_VARIANT elements).
+static bool ArrayToVariant(Local<Array> a, VARIANT& result)
+{
+  std::vector<unsigned> dims;
+  Local<Value> first = a;
+  while (first->IsArray())
+  {
+    Local<Array> level = Local<Array>::Cast(first);
+    dims.push_back(level->Length());
+    if (!level->Length()) break;
+    if (!Nan::Get(level, 0).ToLocal(&first)) return false;
+  }
+  VARTYPE vt = VT_EMPTY;
+  Nan::TryCatch tryCatch;
+  bool bRectangular = ScanArray(a, dims, 0, vt);
+  if (tryCatch.HasCaught())
+  {
+    tryCatch.ReThrow();
+    return false;
+  }
+  if (!bRectangular)
+  {
+    dims.resize(1);
+    dims[0] = a->Length();
+    vt = VT_VARIANT;
+  }
+  if (vt == VT_EMPTY) vt = VT_VARIANT; // no elements at all
+
+  SAFEARRAYBOUND* bounds = (SAFEARRAYBOUND*)alloca(sizeof(SAFEARRAYBOUND) * dims.size());
+  size_t* strides = (size_t*)alloca(sizeof(size_t) * dims.size());
+  size_t stride = 1;
+  for (size_t dim = 0; dim < dims.size(); ++dim)
+  {
+    bounds[dim].lLbound = 0;
+    bounds[dim].cElements = dims[dim];
+    strides[dim] = stride;
+    stride *= dims[dim];
+  }
+  SAFEARRAY* psa = SafeArrayCreate(vt, (UINT)dims.size(), bounds);
+  if (!psa)
+  {
+    Nan::ThrowError(NewOleException(E_OUTOFMEMORY));
+    return false;
+  }
+  // one lock for the whole fill, the elements start out zeroed (VT_EMPTY)
+  void* raw;
+  HRESULT hr = SafeArrayAccessData(psa, &raw);
+  if (FAILED(hr))
+  {
+    SafeArrayDestroy(psa);
+    Nan::ThrowError(NewOleException(hr));
+    return false;
+  }
+  BYTE* data = (BYTE*)raw;
+  bool bOk;
+  switch (vt)
+  {
+  case VT_I4: bOk = FillSafeArray<I4Writer>(a, dims, strides, 0, data, 0, psa->cbElements); break;
+  case VT_R8: bOk = FillSafeArray<R8Writer>(a, dims, strides, 0, data, 0, psa->cbElements); break;
+  case VT_BSTR: bOk = FillSafeArray<BstrWriter>(a, dims, strides, 0, data, 0, psa->cbElements); break;
+  default: bOk = FillSafeArray<VariantWriter>(a, dims, strides, 0, data, 0, psa->cbElements); break;
+  }
+  SafeArrayUnaccessData(psa);
+  if (!bOk)
+  {
+    SafeArrayDestroy(psa); // frees what was stored so far, the exception has been thrown
+    return false;
+  }
+  result.vt = VT_ARRAY | vt;
+  result.parray = psa;
+  return true;
+}
+
+bool V8Variant::ValueToVariant(Handle<Value> v, VARIANT& result, bool bLend, bool bPin)
 {
   if (v->IsNull() || v->IsUndefined()) {
     // todo: make separate undefined type
-    return new OCVariant();
+    return true;
   }
   if (v.IsEmpty() || v->IsExternal() || v->IsNativeError() || v->IsFunction())
   {
     Nan::ThrowTypeError("Cannot interpret this value as a valid OLE value (bad value class)");
-    return NULL;
+    return false;
   }
 // VT_USERDEFINED VT_VARIANT VT_BYREF VT_ARRAY more...
   if(v->IsBoolean() || v->IsBooleanObject()){
-    return new OCVariant(Nan::To<bool>(v).FromJust());
+    result.vt = VT_BOOL;
+    result.boolVal = Nan::To<bool>(v).FromJust() ? VARIANT_TRUE : VARIANT_FALSE;
+    return true;
   }else if(v->IsArray()){
-// VT_BYREF VT_ARRAY VT_SAFEARRAY
-    Nan::ThrowTypeError("Passing Arrays to OLE not currently supported");
-    return NULL;
+    return ArrayToVariant(Local<Array>::Cast(v), result);
+  }else if(v->IsArrayBufferView()){
+    return ViewToVariant(Local<ArrayBufferView>::Cast(v), result, bPin);
   }else if(v->IsInt32()){
-    return new OCVariant((long)Nan::To<int32_t>(v).FromJust());
+    result.vt = VT_I4;
+    result.lVal = (long)Nan::To<int32_t>(v).FromJust();
+    return true;
   }else if(v->IsUint32()){
-    return new OCVariant((long)Nan::To<uint32_t>(v).FromJust(), VT_UI4);
+    result.vt = VT_UI4;
+    result.ulVal = (ULONG)Nan::To<uint32_t>(v).FromJust();
+    return true;
   }else if(v->IsNumber() || v->IsNumberObject()){
-    return new OCVariant(Nan::To<double>(v).FromJust()); // double
+    result.vt = VT_R8;
+    result.dblVal = Nan::To<double>(v).FromJust(); // double
+    return true;
   }else if(v->IsDate()){
-    double d = Nan::To<double>(v).FromJust();
-    time_t sec = (time_t)(d / 1000.0);
-    int msec = (int)(d - sec * 1000.0);
-    struct tm *t = localtime(&sec); // *** must check locale ***
-    if(!t){
+    double d = MsToOleDate(localTime.toLocal(Nan::To<double>(v).FromJust()));
+    if(!(d >= OLE_DATE_MIN && d < OLE_DATE_MAX)){ // invalid Dates are NaN
       Nan::ThrowTypeError("Saw a Date, but couldn't convert it to an OLE value");
-      return NULL;
+      return false;
     }
-    SYSTEMTIME syst;
-    syst.wYear = t->tm_year + 1900;
-    syst.wMonth = t->tm_mon + 1;
-    syst.wDay = t->tm_mday;
-    syst.wHour = t->tm_hour;
-    syst.wMinute = t->tm_min;
-    syst.wSecond = t->tm_sec;
-    syst.wMilliseconds = msec;
-    SystemTimeToVariantTime(&syst, &d);
-    return new OCVariant(d, VT_DATE); // date
+    result.vt = VT_DATE;
+    result.date = d; // date
+    return true;
   }else if(v->IsRegExp()){
     std::cerr << "[RegExp (bug?)]" << std::endl;
     std::cerr.flush();
-    return new OCVariant((const wchar_t*)*String::Value(v->ToDetailString()));
+    return StringToVariant(v->ToDetailString(), result);
   }else if(v->IsString() || v->IsStringObject()){
-    return new OCVariant((const wchar_t*)*String::Value(v));
+    Local<String> s = Nan::To<String>(v).ToLocalChecked();
+    BSTR lent = bLend ? LendString(s) : NULL;
+    if (lent)
+    {
+      result.vt = VT_BSTR;
+      result.bstrVal = lent;
+      result.wReserved1 = LENT_MARK;
+      return true;
+    }
+    return StringToVariant(s, result);
   }else if(v->IsObject()){
     Local<Object> vObj = Local<Object>::Cast(v);
     Local<FunctionTemplate> v8VariantClazz = Nan::New(V8Variant::clazz);
@@ -172,10 +539,12 @@ OCVariant *V8Variant::ValueToVariant(Handle<Value> v)
       V8Variant *v8v = V8Variant::Unwrap<V8Variant>(vObj);
       if (!v8v) {
         Nan::ThrowTypeError("Saw a V8Variant object, but couldn't pull private data");
-        return NULL;
+        return false;
       }
       // std::cerr << ocv->v.vt;
-      return new OCVariant(v8v->ocv);
+      HRESULT hr = VariantCopy(&result, &v8v->ocv.v);
+      if (FAILED(hr)) Nan::ThrowError(NewOleException(hr));
+      return SUCCEEDED(hr);
     }
     Local<FunctionTemplate> v8DispatchClazz = Nan::New(V8Dispatch::clazz);
     if (!v8DispatchClazz->HasInstance(v))
@@ -183,16 +552,19 @@ OCVariant *V8Variant::ValueToVariant(Handle<Value> v)
       V8Dispatch *v8d = V8Dispatch::Unwrap<V8Dispatch>(vObj);
       if (!v8d) {
         Nan::ThrowTypeError("Saw a V8Dispatch object, but couldn't pull private data");
-        return NULL;
+        return false;
       }
       // std::cerr << ocv->v.vt;
-      return new OCVariant(v8d->ocd.disp);
+      result.vt = VT_DISPATCH;
+      result.pdispVal = v8d->ocd.disp;
+      if (result.pdispVal) result.pdispVal->AddRef();
+      return true;
     }
     Local<FunctionTemplate> v8DispMemberClazz = Nan::New(V8DispMember::clazz);
     if (!v8DispMemberClazz->HasInstance(v))
     {
       Handle<Value> innerResult = INSTANCE_CALL(vObj, "toValue", 0, NULL);
-	  return ValueToVariant(innerResult);
+	  return ValueToVariant(innerResult, result);
 	}
   }
   Handle<Value> hFromString = INSTANCE_CALL(Nan::To<Object>(v).ToLocalChecked(), "toString", 0, NULL);
@@ -203,7 +575,7 @@ OCVariant *V8Variant::ValueToVariant(Handle<Value> v)
     String::Utf8Value utfValue(Nan::To<String>(hFromString).ToLocalChecked());
     Nan::ThrowTypeError(("Cannot interpret " + std::string((const char*)*utfValue) + " as a valid OLE value").c_str());
   }
-  return NULL;
+  return false;
 }
 
 NAN_METHOD(V8Variant::OLEIsA)
@@ -342,92 +714,263 @@ NAN_METHOD(V8Variant::OLELocaleStringValue)
 Local<Date> V8Variant::OLEDateToObject(const DATE& dt)
 {
   DISPFUNCIN();
-  SYSTEMTIME syst;
-  VariantTimeToSystemTime(dt, &syst);
-  struct tm t = { 0 }; // set t.tm_isdst = 0
-  t.tm_year = syst.wYear - 1900;
-  t.tm_mon = syst.wMonth - 1;
-  t.tm_mday = syst.wDay;
-  t.tm_hour = syst.wHour;
-  t.tm_min = syst.wMinute;
-  t.tm_sec = syst.wSecond;
+  double ms = localTime.toUtc(OleDateToMs(dt));
   DISPFUNCOUT();
-  return Nan::New<Date>(mktime(&t) * 1000.0 + syst.wMilliseconds).ToLocalChecked();
+  return Nan::New<Date>(ms).ToLocalChecked();
 }
 
-Local<Value> V8Variant::ArrayPrimitiveToValue(void* loc, VARTYPE vt, unsigned cbElements, unsigned idx)
+namespace {
+
+// Strings at least this long (in characters) are handed to V8 as they are instead of copied
+const UINT MIN_EXTERNAL_LENGTH = 16 * 1024;
+
+// A BSTR V8 reads in place, freed when the string is collected
+class ExternalBstr : public String::ExternalStringResource {
+public:
+  explicit ExternalBstr(BSTR bstr) : bstr(bstr), len(SysStringLen(bstr)) {}
+  ~ExternalBstr() { SysFreeString(bstr); }
+  const uint16_t* data() const { return (const uint16_t*)bstr; }
+  size_t length() const { return len; }
+private:
+  BSTR bstr;
+  size_t len;
+};
+
+// copies the characters into dst when every one of them fits in a byte (Latin-1), false as soon as one doesn't
+bool NarrowLatin1(const uint16_t* src, size_t len, uint8_t* dst)
 {
-  /*
-  *  VT_CY               [V][T][P][S]  currency
-  *  VT_UNKNOWN          [V][T]   [S]  IUnknown *
-  *  VT_DECIMAL          [V][T]   [S]  16 byte fixed point
-  *  VT_RECORD           [V]   [P][S]  user defined type
-  */
-  switch (vt)
+  size_t i = 0;
+#ifdef NARROW_SSE2
+  // 8 characters at a time: none may have a high byte, and packing them then loses nothing
+  const __m128i high = _mm_set1_epi16((short)0xff00);
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 8 <= len; i += 8)
   {
-  case VT_DISPATCH:
-    // ASSERT: cbElements == sizeof(IDispatch*)
-    if (reinterpret_cast<IDispatch**>(loc)[idx] == NULL) {
-      return Nan::Null();
-    } else {
-      MaybeLocal<Object> mvReturn = V8Dispatch::CreateNew(reinterpret_cast<IDispatch**>(loc)[idx]);
-      return mvReturn.IsEmpty() ? Local<Value>(Nan::Undefined()) : mvReturn.ToLocalChecked();
+    __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, high), zero)) != 0xffff) return false;
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(units, units));
+  }
+#endif
+  for (; i < len; ++i)
+  {
+    if (src[i] > 0xff) return false;
+    dst[i] = (uint8_t)src[i];
+  }
+  return true;
+}
+
+// copies the characters of a BSTR, by its length so embedded NULs are kept. Most strings read from
+// spreadsheets and databases are plain ASCII, those become one-byte strings taking half the memory
+inline Local<Value> BstrToValue(BSTR bstr)
+{
+  if (!bstr) return Nan::Undefined(); // really shouldn't happen
+  UINT len = SysStringLen(bstr);
+  uint8_t local[256];
+  std::vector<uint8_t> heap;
+  uint8_t* narrow = local;
+  if (len > sizeof(local))
+  {
+    heap.resize(len);
+    narrow = &heap[0];
+  }
+  if (len && NarrowLatin1((const uint16_t*)bstr, len, narrow))
+  {
+    return Nan::NewOneByteString(narrow, (int)len).ToLocalChecked();
+  }
+  return Nan::New<String>((const uint16_t*)bstr, (int)len).ToLocalChecked();
+}
+
+// Element conversions for walking arrays, the kernel is picked once per array instead of once per element
+// and lives for the walk
+template <typename T, typename N>
+struct NumberKernel
+{
+  static Local<Value> toValue(const BYTE* p) { return Nan::New((N)*reinterpret_cast<const T*>(p)); }
+};
+
+struct BoolKernel
+{
+  static Local<Value> toValue(const BYTE* p)
+  {
+    return *reinterpret_cast<const VARIANT_BOOL*>(p) != VARIANT_FALSE ? Nan::True() : Nan::False();
+  }
+};
+
+struct ErrorKernel
+{
+  static Local<Value> toValue(const BYTE* p)
+  {
+    return Exception::Error(Nan::New<String>((const uint16_t*)errorFromCodeW(HRESULT_FROM_WIN32(*reinterpret_cast<const SCODE*>(p))).c_str()).ToLocalChecked());
+  }
+};
+
+// With the stringDedup option, equal short strings met in one array share a single V8 string: columns
+// of a few distinct values (statuses, categories) then cost one string per value instead of per cell.
+// Only lives as long as the walk, while the array is locked and its BSTRs stay put.
+class StringDedup
+{
+public:
+  StringDedup() : enabled(module_options.stringDedup) {}
+  Local<Value> toValue(BSTR bstr)
+  {
+    if (!enabled || !bstr) return BstrToValue(bstr);
+    UINT len = SysStringLen(bstr);
+    if (len > MAX_DEDUP_LENGTH) return BstrToValue(bstr);
+    UINT hash = 2166136261u; // FNV-1a
+    for (UINT i = 0; i < len; ++i) hash = (hash ^ bstr[i]) * 16777619u;
+    std::pair<TSeen::iterator, TSeen::iterator> range = seen.equal_range(hash);
+    for (TSeen::iterator it = range.first; it != range.second; ++it)
+    {
+      BSTR other = it->second.first;
+      if (SysStringLen(other) == len && !memcmp(other, bstr, len * sizeof(OLECHAR))) return it->second.second;
     }
-  case VT_ERROR:
-    // ASSERT: cbElements == sizeof(SCODE)
-    return Exception::Error(Nan::New<String>((const uint16_t*)errorFromCodeW(HRESULT_FROM_WIN32(reinterpret_cast<SCODE*>(loc)[idx])).c_str()).ToLocalChecked());
-  case VT_BOOL:
-    // ASSERT: cbElements == sizeof(VARIANT_BOOL)
-    return reinterpret_cast<VARIANT_BOOL*>(loc)[idx] != VARIANT_FALSE ? Nan::True() : Nan::False();
-  case VT_I1:
-    // ASSERT: cbElements == sizeof(CHAR)
-    return Nan::New(reinterpret_cast<CHAR*>(loc)[idx]);
-  case VT_UI1:
-    // ASSERT: cbElements == sizeof(BYTE)
-    return Nan::New(reinterpret_cast<BYTE*>(loc)[idx]);
-  case VT_I2:
-    // ASSERT: cbElements == sizeof(SHORT)
-    return Nan::New(reinterpret_cast<SHORT*>(loc)[idx]);
-  case VT_UI2:
-    // ASSERT: cbElements == sizeof(USHORT)
-    return Nan::New(reinterpret_cast<USHORT*>(loc)[idx]);
-  case VT_I4:
-    // ASSERT: cbElements == sizeof(LONG)
-    return Nan::New(reinterpret_cast<LONG*>(loc)[idx]);
-  case VT_UI4:
-    // ASSERT: cbElements == sizeof(ULONG)
-    return  Nan::New((uint32_t)reinterpret_cast<ULONG*>(loc)[idx]);
-  case VT_INT:
-    // ASSERT: cbElements == sizeof(INT)
-    return Nan::New(reinterpret_cast<INT*>(loc)[idx]);
-  case VT_UINT:
-    // ASSERT: cbElements == sizeof(UINT)
-    return Nan::New(reinterpret_cast<UINT*>(loc)[idx]);
-  case VT_R4:
-    // ASSERT: cbElements == sizeof(FLOAT)
-    return Nan::New(reinterpret_cast<FLOAT*>(loc)[idx]);
-  case VT_R8:
-    // ASSERT: cbElements == sizeof(DOUBLE)
-    return Nan::New(reinterpret_cast<DOUBLE*>(loc)[idx]);
-  case VT_BSTR:
-    // ASSERT: cbElements == sizeof(BSTR)
-    if (!reinterpret_cast<BSTR*>(loc)[idx]) return Nan::Undefined(); // really shouldn't happen
-    return Nan::New<String>((const uint16_t*)reinterpret_cast<BSTR*>(loc)[idx]).ToLocalChecked();
-  case VT_DATE:
-    // ASSERT: cbElements == sizeof(DATE)
-    return OLEDateToObject(reinterpret_cast<DATE*>(loc)[idx]);
-  case VT_VARIANT:
-    // ASSERT: cbElements == sizeof(VARIANT)
-    return VariantToValue(reinterpret_cast<VARIANT*>(loc)[idx]);
+    Local<Value> value = BstrToValue(bstr);
+    // mostly distinct values aren't worth remembering past a point
+    if (seen.size() < MAX_DEDUP_ENTRIES) seen.insert(TSeen::value_type(hash, std::make_pair(bstr, value)));
+    return value;
+  }
+private:
+  static const UINT MAX_DEDUP_LENGTH = 64;
+  static const size_t MAX_DEDUP_ENTRIES = 4096;
+  typedef std::multimap<UINT, std::pair<BSTR, Local<Value> > > TSeen;
+  bool enabled;
+  TSeen seen;
+};
+
+struct BstrKernel
+{
+  StringDedup strings;
+  Local<Value> toValue(const BYTE* p) { return strings.toValue(*reinterpret_cast<const BSTR*>(p)); }
+};
+
+// reads the wall clock milliseconds OleDatesToMs made of the whole array beforehand
+struct DateKernel
+{
+  static Local<Value> toValue(const BYTE* p)
+  {
+    return Nan::New<Date>(localTime.toUtc(*reinterpret_cast<const double*>(p))).ToLocalChecked();
+  }
+};
+
+struct VariantKernel
+{
+  StringDedup strings; // the strings of a Range.Value come as VARIANTs
+  Local<Value> toValue(const BYTE* p)
+  {
+    const VARIANT& v = *reinterpret_cast<const VARIANT*>(p);
+    return v.vt == VT_BSTR ? strings.toValue(v.bstrVal) : V8Variant::VariantToValue(v);
+  }
+};
+
+struct DispatchKernel
+{
+  static Local<Value> toValue(const BYTE* p)
+  {
+    IDispatch* disp = *reinterpret_cast<IDispatch* const*>(p);
+    if (!disp) return Nan::Null();
+    MaybeLocal<Object> mvReturn = V8Dispatch::CreateNew(disp);
+    return mvReturn.IsEmpty() ? Local<Value>(Nan::Undefined()) : mvReturn.ToLocalChecked();
+  }
+};
+
+struct UndefinedKernel
+{
+  static Local<Value> toValue(const BYTE* p) { return Nan::Undefined(); }
+};
+
+// Frees the SAFEARRAY a Buffer was made over, once V8 has collected it
+void FreeArrayData(char* data, void* hint)
+{
+  SAFEARRAY* psa = (SAFEARRAY*)hint;
+  SafeArrayUnaccessData(psa);
+  SafeArrayDestroy(psa);
+}
+
+// A one-dimensional array of numbers as a TypedArray (a Buffer for bytes) over its data, empty for
+// element types JS has no TypedArray of. With bAdopt the ArrayBuffer takes the array itself over
+// whenever the result isn't empty, otherwise the array stays the caller's and a copy of it is used.
+Local<Value> TypedArrayOf(SAFEARRAY* psa, VARTYPE vt, bool bAdopt)
+{
+  switch (vt)
+  {
+  case VT_I1: case VT_UI1: case VT_I2: case VT_UI2: case VT_I4: case VT_UI4: case VT_INT: case VT_UINT: case VT_R4: case VT_R8:
+    break;
   default:
+    return Local<Value>();
+  }
+  size_t count = psa->rgsabound[0].cElements;
+  size_t bytes = count * psa->cbElements;
+  if (bytes > node::Buffer::kMaxLength) return Local<Value>();
+  Local<Object> buffer;
+  if (!count)
+  {
+    buffer = Nan::NewBuffer(0).ToLocalChecked();
+    if (bAdopt) SafeArrayDestroy(psa);
+  } else {
+    // arrays inside others or behind a reference stay with their owner, those are copied
+    SAFEARRAY* owned = psa;
+    if (!bAdopt && FAILED(SafeArrayCopy(psa, &owned))) return Local<Value>();
+    void* data;
+    if (FAILED(SafeArrayAccessData(owned, &data)))
     {
-      std::cerr << "[unknown type " << vt << " (not implemented now)]" << std::endl;
-      std::cerr.flush();
+      if (!bAdopt) SafeArrayDestroy(owned);
+      return Local<Value>();
     }
-    return Nan::Undefined();
+    MaybeLocal<Object> mb = Nan::NewBuffer((char*)data, bytes, FreeArrayData, owned);
+    // whether node freed the array then depends on its version, better leak it
+    if (mb.IsEmpty()) return bAdopt ? Local<Value>(Nan::Undefined()) : Local<Value>();
+    buffer = mb.ToLocalChecked();
+  }
+  if (vt == VT_UI1) return buffer;
+  Local<ArrayBuffer> ab = Local<Uint8Array>::Cast(buffer)->Buffer();
+  switch (vt)
+  {
+  case VT_I1: return Int8Array::New(ab, 0, count);
+  case VT_I2: return Int16Array::New(ab, 0, count);
+  case VT_UI2: return Uint16Array::New(ab, 0, count);
+  case VT_I4: case VT_INT: return Int32Array::New(ab, 0, count);
+  case VT_UI4: case VT_UINT: return Uint32Array::New(ab, 0, count);
+  case VT_R4: return Float32Array::New(ab, 0, count);
+  default: return Float64Array::New(ab, 0, count);
   }
 }
 
+// Builds the nested arrays of dimensions dim.. (counted from the left, as in VB), the innermost
+// ones are stored in leaves at the position of their first element in memory
+Local<Array> ArrayShape(const unsigned* counts, unsigned dims, unsigned dim, size_t offset, size_t stride, std::vector<Local<Array> >& leaves)
+{
+  Local<Array> result = Nan::New<Array>(counts[dim]);
+  if (dim + 1 == dims)
+  {
+    leaves[offset] = result;
+    return result;
+  }
+  for (unsigned idx = 0; idx < counts[dim]; ++idx)
+  {
+    Nan::Set(result, idx, ArrayShape(counts, dims, dim + 1, offset + idx * stride, stride * counts[dim], leaves));
+  }
+  return result;
+}
+
+// Elements are stored with the leftmost index varying fastest, so one pass over memory sets
+// the same position of every innermost array before moving to the next position
+template <class Kernel>
+void FillArrays(const BYTE* data, unsigned cbElements, std::vector<Local<Array> >& leaves, unsigned count)
+{
+  Kernel kernel;
+  const BYTE* p = data;
+  size_t numLeaves = leaves.size();
+  for (unsigned idx = 0; idx < count; ++idx)
+  {
+    for (size_t leaf = 0; leaf < numLeaves; ++leaf, p += cbElements)
+    {
+      Nan::Set(leaves[leaf], idx, kernel.toValue(p));
+    }
+  }
+}
+
+} // namespace
+
 Local<Value> V8Variant::ArrayToValue(const SAFEARRAY& a)
 {
   OLETRACEIN();
@@ -465,75 +1008,81 @@ Local<Value> V8Variant::ArrayToValue(const SAFEARRAY& a)
     std::cerr.flush();
     return Nan::Undefined();
   }
-  const SAFEARRAYBOUND& bnds = a.rgsabound[0];
   if (a.cDims == 0)
   {
     return Nan::New<Array>(0);
   }
-  else if (a.cDims == 1)
+  if (module_options.typedArrays && a.cDims == 1)
   {
-    // fast array copy, using SafeArrayAccessData
-    Local<Array> result = Nan::New<Array>(bnds.cElements);
-    void* raw;
-    HRESULT hr = SafeArrayAccessData(const_cast<SAFEARRAY*>(&a), &raw);
-    if (FAILED(hr))
-    {
-      std::cerr << "[Unable to access array contents: " << errorFromCode(hr) << "]" << std::endl;
-      std::cerr.flush();
-      return Nan::Undefined();
-    }
-    for (unsigned idx = 0; idx < bnds.cElements; ++idx)
-    {
-      Nan::Set(result, idx, ArrayPrimitiveToValue(raw, vt, a.cbElements, idx));
-    }
-    hr = SafeArrayUnaccessData(const_cast<SAFEARRAY*>(&a));
-    if (FAILED(hr))
-    {
-      std::cerr << "[Unable to release array contents: " << errorFromCode(hr) << "]" << std::endl;
-      std::cerr.flush();
-    }
-    return result;
-  } else {
-    // slow array copy, using SafeArrayGetElement
-    Local<Array> result = Nan::New<Array>(bnds.cElements);
-    for (unsigned idx = 0; idx < bnds.cElements; ++idx)
-    {
-      LONG srcIndex = idx + bnds.lLbound;
-      Nan::Set(result, idx, ArrayToValueSlow(a, vt, &srcIndex, 1));
-    }
-    return result;
+    Local<Value> typed = TypedArrayOf(const_cast<SAFEARRAY*>(&a), vt, false);
+    if (!typed.IsEmpty()) return typed;
   }
-  OLETRACEOUT();
-}
+  // the bounds are stored rightmost dimension first
+  unsigned* counts = (unsigned*)alloca(sizeof(unsigned) * a.cDims);
+  size_t numLeaves = 1;
+  for (unsigned dim = 0; dim < a.cDims; ++dim)
+  {
+    counts[dim] = a.rgsabound[a.cDims - dim - 1].cElements;
+    if (dim + 1 < a.cDims) numLeaves *= counts[dim];
+  }
+  std::vector<Local<Array> > leaves(numLeaves);
+  Local<Array> result = ArrayShape(counts, a.cDims, 0, 0, 1, leaves);
 
-Local<Value> V8Variant::ArrayToValueSlow(const SAFEARRAY& a, VARTYPE vt, LONG* idices, unsigned numIdx)
-{
-  OLETRACEIN();
-  OLETRACEFLUSH();
-  if (numIdx <= a.cDims)
+  // one lock for the whole walk
+  void* raw;
+  HRESULT hr = SafeArrayAccessData(const_cast<SAFEARRAY*>(&a), &raw);
+  if (FAILED(hr))
   {
-    void* elm = alloca(a.cbElements);
-    HRESULT hr = SafeArrayGetElement(const_cast<SAFEARRAY*>(&a), idices, elm);
-    if (FAILED(hr))
-    {
-      std::cerr << "[Unable to access array element: " << errorFromCode(hr) << "]" << std::endl;
-      std::cerr.flush();
-      return Nan::Undefined();
-    }
-    return ArrayPrimitiveToValue(elm, vt, a.cbElements, 0);
-  } else {
-    LONG* newIdx = (LONG*)alloca(sizeof(LONG) * (numIdx + 1));
-    memcpy(newIdx, idices, sizeof(LONG)*numIdx);
-    const SAFEARRAYBOUND& bnds = a.rgsabound[numIdx-1];
-    Local<Array> result = Nan::New<Array>(bnds.cElements);
-    for (unsigned idx = 0; idx < bnds.cElements; ++idx)
+    std::cerr << "[Unable to access array contents: " << errorFromCode(hr) << "]" << std::endl;
+    std::cerr.flush();
+    return Nan::Undefined();
+  }
+  const BYTE* data = (const BYTE*)raw;
+  unsigned count = counts[a.cDims - 1];
+  switch (vt)
+  {
+  case VT_DISPATCH: FillArrays<DispatchKernel>(data, a.cbElements, leaves, count); break;
+  case VT_ERROR: FillArrays<ErrorKernel>(data, a.cbElements, leaves, count); break;
+  case VT_BOOL: FillArrays<BoolKernel>(data, a.cbElements, leaves, count); break;
+  case VT_I1: FillArrays<NumberKernel<CHAR, int32_t> >(data, a.cbElements, leaves, count); break;
+  case VT_UI1: FillArrays<NumberKernel<BYTE, int32_t> >(data, a.cbElements, leaves, count); break;
+  case VT_I2: FillArrays<NumberKernel<SHORT, int32_t> >(data, a.cbElements, leaves, count); break;
+  case VT_UI2: FillArrays<NumberKernel<USHORT, int32_t> >(data, a.cbElements, leaves, count); break;
+  case VT_I4: FillArrays<NumberKernel<LONG, int32_t> >(data, a.cbElements, leaves, count); break;
+  case VT_UI4: FillArrays<NumberKernel<ULONG, uint32_t> >(data, a.cbElements, leaves, count); break;
+  case VT_INT: FillArrays<NumberKernel<INT, int32_t> >(data, a.cbElements, leaves, count); break;
+  case VT_UINT: FillArrays<NumberKernel<UINT, uint32_t> >(data, a.cbElements, leaves, count); break;
+  case VT_R4: FillArrays<NumberKernel<FLOAT, double> >(data, a.cbElements, leaves, count); break;
+  case VT_R8: FillArrays<NumberKernel<DOUBLE, double> >(data, a.cbElements, leaves, count); break;
+  case VT_BSTR: FillArrays<BstrKernel>(data, a.cbElements, leaves, count); break;
+  case VT_DATE:
     {
-      newIdx[numIdx] = idx + bnds.lLbound;
-      Nan::Set(result, idx, ArrayToValueSlow(a, vt, newIdx, numIdx+1));
+      std::vector<double> ms(numLeaves * count);
+      if (!ms.empty()) OleDatesToMs(reinterpret_cast<const DATE*>(data), &ms[0], ms.size());
+      FillArrays<DateKernel>(ms.empty() ? data : reinterpret_cast<const BYTE*>(&ms[0]), sizeof(double), leaves, count);
     }
-    return result;
+    break;
+  case VT_VARIANT: FillArrays<VariantKernel>(data, a.cbElements, leaves, count); break;
+  default:
+    /*
+    *  VT_CY               [V][T][P][S]  currency
+    *  VT_UNKNOWN          [V][T]   [S]  IUnknown *
+    *  VT_DECIMAL          [V][T]   [S]  16 byte fixed point
+    *  VT_RECORD           [V]   [P][S]  user defined type
+    */
+    std::cerr << "[unknown type " << vt << " (not implemented now)]" << std::endl;
+    std::cerr.flush();
+    FillArrays<UndefinedKernel>(data, a.cbElements, leaves, count);
+    break;
+  }
+  hr = SafeArrayUnaccessData(const_cast<SAFEARRAY*>(&a));
+  if (FAILED(hr))
+  {
+    std::cerr << "[Unable to release array contents: " << errorFromCode(hr) << "]" << std::endl;
+    std::cerr.flush();
   }
   OLETRACEOUT();
+  return result;
 }
 
 Local<Value> V8Variant::VariantToValue(const VARIANT& v)
@@ -628,11 +1177,10 @@ Local<Value> V8Variant::VariantToValue(const VARIANT& v)
     if (!v.pdblVal) return Nan::Undefined(); // really shouldn't happen
     return Nan::New(*v.pdblVal);
   case VT_BSTR:
-    if (!v.bstrVal) return Nan::Undefined(); // really shouldn't happen
-    return Nan::New<String>((const uint16_t*)v.bstrVal).ToLocalChecked();
+    return BstrToValue(v.bstrVal);
   case VT_BSTR | VT_BYREF:
-    if (!v.pbstrVal || !*v.pbstrVal) return Nan::Undefined(); // really shouldn't happen
-    return Nan::New<String>((const uint16_t*)*v.pbstrVal).ToLocalChecked();
+    if (!v.pbstrVal) return Nan::Undefined(); // really shouldn't happen
+    return BstrToValue(*v.pbstrVal);
   case VT_DATE:
     return OLEDateToObject(v.date);
   case VT_DATE | VT_BYREF:
@@ -672,6 +1220,32 @@ Local<Value> V8Variant::VariantToValue(const VARIANT& v)
   OLETRACEOUT();
 }
 
+Local<Value> V8Variant::ResultToValue(VARIANT& v)
+{
+  if ((v.vt & ~VT_TYPEMASK) == VT_ARRAY && v.parray && v.parray->cDims == 1 && module_options.typedArrays)
+  {
+    // the array becomes the ArrayBuffer's storage as it is
+    Local<Value> typed = TypedArrayOf(v.parray, v.vt & VT_TYPEMASK, true);
+    if (!typed.IsEmpty())
+    {
+      VariantInit(&v);
+      return typed;
+    }
+  }
+  if (v.vt != VT_BSTR || !v.bstrVal || SysStringLen(v.bstrVal) < MIN_EXTERNAL_LENGTH) return VariantToValue(v);
+  // a long string (a document's text, some XML) becomes the V8 string's storage, without a second copy of it
+  ExternalBstr* resource = new ExternalBstr(v.bstrVal);
+  MaybeLocal<String> ms = Nan::New<String>(resource);
+  if (ms.IsEmpty())
+  {
+    delete resource; // frees the BSTR too
+    VariantInit(&v);
+    return Nan::Undefined();
+  }
+  VariantInit(&v); // the string owns it now
+  return ms.ToLocalChecked();
+}
+
 static std::string GetName(ITypeInfo *typeinfo, MEMBERID id) {
   BSTR name;
   UINT numNames = 0;
@@ -29,7 +29,22 @@ public:
   static NAN_METHOD(New);
   static NAN_METHOD(Finalize);
   static Local<Value> VariantToValue(const VARIANT& ocv);
-  static ole32core::OCVariant *ValueToVariant(Handle<Value> v); // *** private
+  // for a result the caller is done with: long strings and (with the typedArrays option) arrays of
+  // numbers are taken over instead of copied, leaving v empty
+  static Local<Value> ResultToValue(VARIANT& v);
+  // result must be empty, throws and returns false if v can't be converted. With bLend, short strings
+  // may come as a BSTR lent by the string cache, with bPin TypedArrays and Buffers as a SAFEARRAY over
+  // their own memory (for calls made before v can go away); such a result must be released with ClearArgument
+  static bool ValueToVariant(Handle<Value> v, VARIANT& result, bool bLend = false, bool bPin = false);
+  static void ClearArgument(VARIANT& v);
+  static Local<Date> OLEDateToObject(const DATE& dt);
+  struct StringCacheStats {
+    size_t hits;
+    size_t misses;
+    size_t entries;
+  };
+  static void SetStringCacheSize(unsigned size); // 0 turns it off
+  static void GetStringCacheStats(StringCacheStats& stats);
 public:
   V8Variant() : finalized(false) {}
   ~V8Variant() { if(!finalized) Finalize(); }
@@ -37,10 +52,8 @@ public:
 protected:
   void Finalize();
   static Local<Value> resolveValueChain(Local<Object> thisObject, const char* prop);
-  static Local<Date> OLEDateToObject(const DATE& dt);
+  // nested arrays with the leftmost dimension outermost, as a(i, j) reads in VB
   static Local<Value> ArrayToValue(const SAFEARRAY& a);
-  static Local<Value> ArrayToValueSlow(const SAFEARRAY& a, VARTYPE vt, LONG* idices, unsigned numIdx);
-  static Local<Value> ArrayPrimitiveToValue(void* loc, VARTYPE vt, unsigned cbElements, unsigned idx);
 protected:
   bool finalized;
 };
@@ -0,0 +1,277 @@
+/*
+  win32ole_bindings.cc
+  Native side of the bindings generated by lib/bindgen.js
+*/
+
+#include "node_win32ole.h"
+#include <node.h>
+#include <nan.h>
+#include "ole32core.h"
+#include "oletypeinfo.h"
+#include "v8dispatch.h"
+#include "v8disppath.h"
+#include "v8variant.h"
+
+using namespace v8;
+using namespace ole32core;
+
+namespace node_win32ole {
+
+namespace {
+
+Local<String> BSTRToString(BSTR bstr)
+{
+  return Nan::New((const uint16_t*)(bstr ? bstr : L""), bstr ? (int)SysStringLen(bstr) : 0).ToLocalChecked();
+}
+
+Local<String> GUIDToString(const GUID& guid)
+{
+  wchar_t szGuid[40];
+  if (!StringFromGUID2(guid, szGuid, sizeof(szGuid) / sizeof(szGuid[0]))) szGuid[0] = L'\0';
+  return Nan::New((const uint16_t*)szGuid).ToLocalChecked();
+}
+
+Local<Object> NewParam(Local<String> name, VARTYPE vt, bool optional)
+{
+  Local<Object> param = Nan::New<Object>();
+  Nan::Set(param, Nan::New("name").ToLocalChecked(), name);
+  Nan::Set(param, Nan::New("vt").ToLocalChecked(), Nan::New<Uint32>((uint32_t)vt));
+  Nan::Set(param, Nan::New("optional").ToLocalChecked(), Nan::New(optional));
+  return param;
+}
+
+Local<Object> NewMember(Local<String> name, DISPID memid, int invkind, VARTYPE result, bool hidden, Local<Array> params)
+{
+  Local<Object> member = Nan::New<Object>();
+  Nan::Set(member, Nan::New("name").ToLocalChecked(), name);
+  Nan::Set(member, Nan::New("dispid").ToLocalChecked(), Nan::New<Int32>((int32_t)memid));
+  Nan::Set(member, Nan::New("invkind").ToLocalChecked(), Nan::New<Int32>(invkind));
+  Nan::Set(member, Nan::New("result").ToLocalChecked(), Nan::New<Uint32>((uint32_t)result));
+  Nan::Set(member, Nan::New("hidden").ToLocalChecked(), Nan::New(hidden));
+  Nan::Set(member, Nan::New("params").ToLocalChecked(), params);
+  return member;
+}
+
+// one entry per invoke kind, so a read/write property shows up once as a get and once as a put
+void DescribeFunc(ITypeInfo* tinfo, const FUNCDESC* funcdesc, Local<Array> members)
+{
+  UINT numNames = 0;
+  BSTR* bNames = (BSTR*)alloca(sizeof(BSTR) * (funcdesc->cParams + 1));
+  if (FAILED(tinfo->GetNames(funcdesc->memid, bNames, funcdesc->cParams + 1, &numNames)) || !numNames) return;
+
+  Local<Array> params = Nan::New<Array>();
+  int idx = 0;
+  for (int p = 0; p < funcdesc->cParams; ++p)
+  {
+    const ELEMDESC& elemdesc = funcdesc->lprgelemdescParam[p];
+    USHORT flags = elemdesc.paramdesc.wParamFlags;
+    if (flags & (PARAMFLAG_FRETVAL | PARAMFLAG_FLCID)) continue; // supplied by IDispatch::Invoke
+    // the value of a property put has no name of its own
+    Local<String> name = (UINT)(p + 1) < numNames ? BSTRToString(bNames[p + 1])
+      : Nan::New(p == funcdesc->cParams - 1 && funcdesc->invkind != INVOKE_FUNC ? std::string("value") : "arg" + to_s(p)).ToLocalChecked();
+    bool optional = (flags & (PARAMFLAG_FOPT | PARAMFLAG_FHASDEFAULT)) || p >= funcdesc->cParams - funcdesc->cParamsOpt;
+    Nan::Set(params, idx++, NewParam(name, resolveVarType(tinfo, elemdesc.tdesc), optional));
+  }
+
+  bool hidden = (funcdesc->wFuncFlags & (FUNCFLAG_FHIDDEN | FUNCFLAG_FNONBROWSABLE)) != 0;
+  Nan::Set(members, members->Length(), NewMember(BSTRToString(bNames[0]), funcdesc->memid, funcdesc->invkind,
+    resolveVarType(tinfo, funcdesc->elemdescFunc.tdesc), hidden, params));
+  for (UINT i = 0; i < numNames; ++i) SysFreeString(bNames[i]);
+}
+
+void DescribeVar(ITypeInfo* tinfo, const VARDESC* vardesc, Local<Array> members)
+{
+  BSTR bName;
+  UINT numNames;
+  if (FAILED(tinfo->GetNames(vardesc->memid, &bName, 1, &numNames)) || !numNames) return;
+  Local<String> name = BSTRToString(bName);
+  SysFreeString(bName);
+
+  VARTYPE vt = resolveVarType(tinfo, vardesc->elemdescVar.tdesc);
+  bool hidden = (vardesc->wVarFlags & (VARFLAG_FHIDDEN | VARFLAG_FNONBROWSABLE)) != 0;
+  Nan::Set(members, members->Length(), NewMember(name, vardesc->memid, INVOKE_PROPERTYGET, vt, hidden, Nan::New<Array>()));
+  if (!(vardesc->wVarFlags & VARFLAG_FREADONLY))
+  {
+    Local<Array> params = Nan::New<Array>();
+    Nan::Set(params, 0, NewParam(Nan::New("value").ToLocalChecked(), vt, false));
+    Nan::Set(members, members->Length(), NewMember(name, vardesc->memid, INVOKE_PROPERTYPUT, VT_VOID, hidden, params));
+  }
+}
+
+Local<Object> DescribeType(ITypeInfo* tinfo, const TYPEATTR* tattr)
+{
+  Local<Object> type = Nan::New<Object>();
+  BSTR bName = NULL;
+  tinfo->GetDocumentation(MEMBERID_NIL, &bName, NULL, NULL, NULL);
+  Nan::Set(type, Nan::New("name").ToLocalChecked(), BSTRToString(bName));
+  if (bName) SysFreeString(bName);
+  Nan::Set(type, Nan::New("guid").ToLocalChecked(), GUIDToString(tattr->guid));
+  Nan::Set(type, Nan::New("dual").ToLocalChecked(), Nan::New((tattr->wTypeFlags & TYPEFLAG_FDUAL) != 0));
+
+  Local<Array> members = Nan::New<Array>();
+  for (int i = 0; i < tattr->cFuncs; ++i)
+  {
+    FUNCDESC* funcdesc;
+    if (FAILED(tinfo->GetFuncDesc(i, &funcdesc))) continue;
+    if (!(funcdesc->wFuncFlags & FUNCFLAG_FRESTRICTED)) DescribeFunc(tinfo, funcdesc, members);
+    tinfo->ReleaseFuncDesc(funcdesc);
+  }
+  for (int i = 0; i < tattr->cVars; ++i)
+  {
+    VARDESC* vardesc;
+    if (FAILED(tinfo->GetVarDesc(i, &vardesc))) continue;
+    if (!(vardesc->wVarFlags & VARFLAG_FRESTRICTED)) DescribeVar(tinfo, vardesc, members);
+    tinfo->ReleaseVarDesc(vardesc);
+  }
+  Nan::Set(type, Nan::New("members").ToLocalChecked(), members);
+  return type;
+}
+
+Local<Object> DescribeLibrary(ITypeLib* tlib)
+{
+  Local<Object> library = Nan::New<Object>();
+  BSTR bName = NULL;
+  tlib->GetDocumentation(-1, &bName, NULL, NULL, NULL);
+  Nan::Set(library, Nan::New("name").ToLocalChecked(), BSTRToString(bName));
+  if (bName) SysFreeString(bName);
+  TLIBATTR* lattr;
+  if (SUCCEEDED(tlib->GetLibAttr(&lattr)))
+  {
+    Nan::Set(library, Nan::New("guid").ToLocalChecked(), GUIDToString(lattr->guid));
+    Nan::Set(library, Nan::New("major").ToLocalChecked(), Nan::New<Uint32>((uint32_t)lattr->wMajorVerNum));
+    Nan::Set(library, Nan::New("minor").ToLocalChecked(), Nan::New<Uint32>((uint32_t)lattr->wMinorVerNum));
+    Nan::Set(library, Nan::New("lcid").ToLocalChecked(), Nan::New<Uint32>((uint32_t)lattr->lcid));
+    tlib->ReleaseTLibAttr(lattr);
+  }
+
+  // only dispinterfaces (and the dispatch half of dual interfaces) can be called through IDispatch
+  Local<Array> types = Nan::New<Array>();
+  UINT count = tlib->GetTypeInfoCount();
+  for (UINT i = 0; i < count; ++i)
+  {
+    TYPEKIND kind;
+    if (FAILED(tlib->GetTypeInfoType(i, &kind)) || kind != TKIND_DISPATCH) continue;
+    ITypeInfo* tinfo;
+    if (FAILED(tlib->GetTypeInfo(i, &tinfo))) continue;
+    TYPEATTR* tattr;
+    if (SUCCEEDED(tinfo->GetTypeAttr(&tattr)))
+    {
+      Nan::Set(types, types->Length(), DescribeType(tinfo, tattr));
+      tinfo->ReleaseTypeAttr(tattr);
+    }
+    tinfo->Release();
+  }
+  Nan::Set(library, Nan::New("types").ToLocalChecked(), types);
+  return library;
+}
+
+} // namespace
+
+NAN_METHOD(Method_invoke) // dispatch, DISPID, DISPATCH_* flags, [VARTYPE...] or null, args...
+{
+  OLETRACEIN();
+  OLETRACEARGS();
+  Local<FunctionTemplate> v8DispatchClazz = Nan::New(V8Dispatch::clazz);
+  if (info.Length() < 3 || !info[0]->IsObject() || !v8DispatchClazz->HasInstance(info[0]))
+    return Nan::ThrowTypeError("Argument 1 is not a V8Dispatch object");
+  if (!info[1]->IsInt32())
+    return Nan::ThrowTypeError("Argument 2 is not a DISPID");
+  if (!info[2]->IsUint32())
+    return Nan::ThrowTypeError("Argument 3 is not a DISPATCH_* flag");
+  V8Dispatch* vDisp = V8Dispatch::Unwrap<V8Dispatch>(Local<Object>::Cast(info[0]));
+  CHECK_V8(V8Dispatch, vDisp);
+  DISPID dispID = (DISPID)Nan::To<int32_t>(info[1]).FromJust();
+  WORD targetType = (WORD)Nan::To<uint32_t>(info[2]).FromJust();
+
+  // trailing undefined arguments are optional ones the caller left out
+  int argc = info.Length() > 4 ? info.Length() - 4 : 0;
+  while (argc > 0 && info[3 + argc]->IsUndefined()) --argc;
+  Local<Value>* argv = (Local<Value>*)alloca(sizeof(Local<Value>) * (argc ? argc : 1));
+  for (int idx = 0; idx < argc; ++idx)
+  {
+    *(new(argv + idx) Local<Value>) = info[4 + idx];
+  }
+  VARTYPE* argTypes = NULL;
+  if (info.Length() > 3 && info[3]->IsArray())
+  {
+    Local<Array> vts = Local<Array>::Cast(info[3]);
+    argTypes = (VARTYPE*)alloca(sizeof(VARTYPE) * (argc ? argc : 1));
+    for (int idx = 0; idx < argc; ++idx)
+    {
+      Local<Value> vt;
+      argTypes[idx] = (uint32_t)idx < vts->Length() && Nan::Get(vts, idx).ToLocal(&vt) && vt->IsUint32()
+        ? (VARTYPE)Nan::To<uint32_t>(vt).FromJust() : (VARTYPE)VT_VARIANT;
+    }
+  }
+
+  Local<Value> vResult = vDisp->OLECall(dispID, argc, argv, targetType, argTypes);
+  for (int idx = 0; idx < argc; ++idx)
+  {
+    (argv + idx)->~Local<Value>();
+  }
+  if (!vResult->IsUndefined()) info.GetReturnValue().Set(vResult);
+  OLETRACEOUT();
+}
+
+NAN_METHOD(Method_batch) // dispatch, [[name | DISPID, DISPATCH_* flags, [args]]...] -> [results]
+{
+  OLETRACEIN();
+  Local<FunctionTemplate> v8DispatchClazz = Nan::New(V8Dispatch::clazz);
+  if (info.Length() < 2 || !info[0]->IsObject() || !v8DispatchClazz->HasInstance(info[0]))
+    return Nan::ThrowTypeError("Argument 1 is not a V8Dispatch object");
+  if (!info[1]->IsArray())
+    return Nan::ThrowTypeError("Argument 2 is not an Array of operations");
+  V8Dispatch* vDisp = V8Dispatch::Unwrap<V8Dispatch>(Local<Object>::Cast(info[0]));
+  CHECK_V8(V8Dispatch, vDisp);
+  Local<Array> results = vDisp->OLEBatch(Local<Array>::Cast(info[1]));
+  info.GetReturnValue().Set(results);
+  OLETRACEOUT();
+}
+
+NAN_METHOD(Method_compile) // dispatch, path -> function(dispatch, args..., [value])
+{
+  OLETRACEIN();
+  Local<FunctionTemplate> v8DispatchClazz = Nan::New(V8Dispatch::clazz);
+  if (info.Length() < 2 || !info[0]->IsObject() || !v8DispatchClazz->HasInstance(info[0]))
+    return Nan::ThrowTypeError("Argument 1 is not a V8Dispatch object");
+  if (!info[1]->IsString())
+    return Nan::ThrowTypeError("Argument 2 is not a String");
+  MaybeLocal<Object> mPath = V8DispPath::CreateNew(Local<Object>::Cast(info[0]), Local<String>::Cast(info[1]));
+  if (mPath.IsEmpty()) return; // the member path didn't compile
+  info.GetReturnValue().Set(mPath.ToLocalChecked());
+  OLETRACEOUT();
+}
+
+NAN_METHOD(Method_typeLibrary) // path or V8Dispatch -> description of every dispinterface in the library
+{
+  ITypeLib* tlib = NULL;
+  HRESULT hr;
+  Local<FunctionTemplate> v8DispatchClazz = Nan::New(V8Dispatch::clazz);
+  if (info.Length() >= 1 && info[0]->IsObject() && v8DispatchClazz->HasInstance(info[0]))
+  {
+    V8Dispatch* vDisp = V8Dispatch::Unwrap<V8Dispatch>(Local<Object>::Cast(info[0]));
+    CHECK_V8(V8Dispatch, vDisp);
+    ITypeInfo* tinfo = vDisp->ocd.getTypeInfo();
+    UINT idx;
+    hr = tinfo ? tinfo->GetContainingTypeLib(&tlib, &idx) : E_NOINTERFACE;
+  }
+  else if (info.Length() >= 1 && info[0]->IsString())
+  {
+    String::Utf8Value u8s(info[0]);
+    wchar_t *wcs = u8s2wcs(*u8s);
+    if (!wcs) return Nan::ThrowError(NewOleException(GetLastError()));
+    hr = LoadTypeLibEx(wcs, REGKIND_NONE, &tlib);
+    free(wcs);
+  }
+  else
+  {
+    return Nan::ThrowTypeError("Argument 1 must be a type library path or a V8Dispatch object");
+  }
+  if (FAILED(hr)) return Nan::ThrowError(NewOleException(hr));
+
+  Local<Object> result = DescribeLibrary(tlib);
+  tlib->Release();
+  return info.GetReturnValue().Set(result);
+}
+
+} // namespace node_win32ole
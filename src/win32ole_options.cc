@@ -0,0 +1,152 @@
+/*
+  win32ole_options.cc
+*/
+
+#include "node_win32ole.h"
+#include <node.h>
+#include <nan.h>
+#include "ole32core.h"
+#include "oletypeinfo.h"
+#include "oletypeindex.h"
+#include "v8variant.h"
+
+using namespace v8;
+using namespace ole32core;
+
+namespace node_win32ole {
+
+Win32OLEOptions module_options = {
+  nc_Object, // nameCache
+  true, // lazyBinding
+  false, // typedTemplates
+  false, // vtableCalls
+  0, // stringCache
+  0, // apartmentThreads
+  false, // typedArrays
+  false // stringDedup
+};
+
+static const char* nameCacheModes[] = { "none", "object", "shared" };
+
+bool ParseNameCacheMode(Local<Value> value, int* mode)
+{
+  if (value->IsBoolean())
+  {
+    *mode = value->BooleanValue() ? nc_Object : nc_None;
+    return true;
+  }
+  if (!value->IsString()) return false;
+  String::Utf8Value u8s(value);
+  for (int i = 0; i < (int)(sizeof(nameCacheModes) / sizeof(nameCacheModes[0])); ++i)
+  {
+    if (!strcmp(*u8s, nameCacheModes[i]))
+    {
+      *mode = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+NAN_METHOD(Method_option) // returns the current value, and sets a new one if given
+{
+  if (info.Length() < 1 || !info[0]->IsString())
+    return Nan::ThrowTypeError("Argument 1 is not a String");
+  String::Utf8Value u8s(info[0]);
+  std::string name(*u8s);
+  if (name == "nameCache")
+  {
+    Local<String> current = Nan::New(nameCacheModes[module_options.nameCache]).ToLocalChecked();
+    if (info.Length() >= 2 && !ParseNameCacheMode(info[1], &module_options.nameCache))
+      return Nan::ThrowTypeError("nameCache must be 'none', 'object' or 'shared'");
+    return info.GetReturnValue().Set(current);
+  }
+  if (name == "lazyBinding")
+  {
+    bool current = module_options.lazyBinding;
+    if (info.Length() >= 2)
+    {
+      if (!info[1]->IsBoolean()) return Nan::ThrowTypeError("lazyBinding must be a Boolean");
+      module_options.lazyBinding = info[1]->BooleanValue();
+    }
+    return info.GetReturnValue().Set(current);
+  }
+  if (name == "typedTemplates")
+  {
+    bool current = module_options.typedTemplates;
+    if (info.Length() >= 2)
+    {
+      if (!info[1]->IsBoolean()) return Nan::ThrowTypeError("typedTemplates must be a Boolean");
+      module_options.typedTemplates = info[1]->BooleanValue();
+    }
+    return info.GetReturnValue().Set(current);
+  }
+  if (name == "vtableCalls")
+  {
+    bool current = module_options.vtableCalls;
+    if (info.Length() >= 2)
+    {
+      if (!info[1]->IsBoolean()) return Nan::ThrowTypeError("vtableCalls must be a Boolean");
+      module_options.vtableCalls = info[1]->BooleanValue();
+    }
+    return info.GetReturnValue().Set(current);
+  }
+  if (name == "stringCache")
+  {
+    Local<Uint32> current = Nan::New<Uint32>((uint32_t)module_options.stringCache);
+    if (info.Length() >= 2)
+    {
+      if (!info[1]->IsUint32()) return Nan::ThrowTypeError("stringCache must be a number of strings, or 0 to disable it");
+      module_options.stringCache = Nan::To<uint32_t>(info[1]).FromJust();
+      V8Variant::SetStringCacheSize(module_options.stringCache);
+    }
+    return info.GetReturnValue().Set(current);
+  }
+  if (name == "apartmentThreads")
+  {
+    Local<Uint32> current = Nan::New<Uint32>((uint32_t)module_options.apartmentThreads);
+    if (info.Length() >= 2)
+    {
+      if (!info[1]->IsUint32()) return Nan::ThrowTypeError("apartmentThreads must be a number of threads, or 0 for one per processor");
+      module_options.apartmentThreads = Nan::To<uint32_t>(info[1]).FromJust(); // read when the pool starts
+    }
+    return info.GetReturnValue().Set(current);
+  }
+  if (name == "typedArrays")
+  {
+    bool current = module_options.typedArrays;
+    if (info.Length() >= 2)
+    {
+      if (!info[1]->IsBoolean()) return Nan::ThrowTypeError("typedArrays must be a Boolean");
+      module_options.typedArrays = info[1]->BooleanValue();
+    }
+    return info.GetReturnValue().Set(current);
+  }
+  if (name == "stringDedup")
+  {
+    bool current = module_options.stringDedup;
+    if (info.Length() >= 2)
+    {
+      if (!info[1]->IsBoolean()) return Nan::ThrowTypeError("stringDedup must be a Boolean");
+      module_options.stringDedup = info[1]->BooleanValue();
+    }
+    return info.GetReturnValue().Set(current);
+  }
+  if (name == "typeIndex")
+  {
+    Local<String> current = Nan::New((const uint16_t*)OCTypeIndex::getDirectory().c_str()).ToLocalChecked();
+    if (info.Length() >= 2)
+    {
+      if (!info[1]->IsString()) return Nan::ThrowTypeError("typeIndex must be a directory name, or '' to disable it");
+      String::Utf8Value u8dir(info[1]);
+      wchar_t *wcs = u8s2wcs(*u8dir);
+      if (!wcs) return Nan::ThrowError(NewOleException(GetLastError()));
+      OCTypeIndex::setDirectory(wcs);
+      free(wcs);
+    }
+    return info.GetReturnValue().Set(current);
+  }
+  return Nan::ThrowError(("unknown option: " + name).c_str());
+}
+
+} // namespace node_win32ole
@@ -0,0 +1,49 @@
+/*
+  win32ole_stats.cc
+*/
+
+#include "node_win32ole.h"
+#include <node.h>
+#include <nan.h>
+#include "ole32core.h"
+#include "oletypeinfo.h"
+#include "v8variant.h"
+
+using namespace v8;
+using namespace ole32core;
+
+namespace node_win32ole {
+
+NAN_METHOD(Method_stats) // returns counters of the internal caches
+{
+  Local<Object> result = Nan::New<Object>();
+
+  OCTypeCache::Stats typeStats;
+  OCTypeCache::getStats(typeStats);
+  Local<Object> typeCache = Nan::New<Object>();
+  Nan::Set(typeCache, Nan::New("hits").ToLocalChecked(), Nan::New<Uint32>((uint32_t)typeStats.hits));
+  Nan::Set(typeCache, Nan::New("misses").ToLocalChecked(), Nan::New<Uint32>((uint32_t)typeStats.misses));
+  Nan::Set(typeCache, Nan::New("entries").ToLocalChecked(), Nan::New<Uint32>((uint32_t)typeStats.entries));
+  Nan::Set(typeCache, Nan::New("indexed").ToLocalChecked(), Nan::New<Uint32>((uint32_t)typeStats.indexed));
+  Nan::Set(result, Nan::New("typeCache").ToLocalChecked(), typeCache);
+
+  OCNameCache::Stats nameStats;
+  OCNameCache::getStats(nameStats);
+  Local<Object> nameCache = Nan::New<Object>();
+  Nan::Set(nameCache, Nan::New("hits").ToLocalChecked(), Nan::New<Uint32>((uint32_t)nameStats.hits));
+  Nan::Set(nameCache, Nan::New("misses").ToLocalChecked(), Nan::New<Uint32>((uint32_t)nameStats.misses));
+  Nan::Set(nameCache, Nan::New("shared").ToLocalChecked(), Nan::New<Uint32>((uint32_t)nameStats.shared));
+  Nan::Set(result, Nan::New("nameCache").ToLocalChecked(), nameCache);
+
+  V8Variant::StringCacheStats stringStats;
+  V8Variant::GetStringCacheStats(stringStats);
+  Local<Object> stringCache = Nan::New<Object>();
+  Nan::Set(stringCache, Nan::New("hits").ToLocalChecked(), Nan::New<Uint32>((uint32_t)stringStats.hits));
+  Nan::Set(stringCache, Nan::New("misses").ToLocalChecked(), Nan::New<Uint32>((uint32_t)stringStats.misses));
+  Nan::Set(stringCache, Nan::New("entries").ToLocalChecked(), Nan::New<Uint32>((uint32_t)stringStats.entries));
+  Nan::Set(result, Nan::New("stringCache").ToLocalChecked(), stringCache);
+
+  return info.GetReturnValue().Set(result);
+}
+
+} // namespace node_win32ole
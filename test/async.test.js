@@ -0,0 +1,126 @@
+var win32ole = require('win32ole');
+win32ole.print('async.test\n');
+var assert = require('assert');
+
+// resolves done with the value of promise checked by check, or fails it
+function settles(promise, check, done){
+  assert.ok(promise instanceof Promise);
+  promise.then(function(value){
+    check(value);
+    done();
+  }).catch(done);
+}
+
+function rejects(promise, check, done){
+  assert.ok(promise instanceof Promise);
+  promise.then(function(value){
+    done(new Error('resolved with ' + value));
+  }, function(e){
+    check(e);
+    done();
+  }).catch(done);
+}
+
+describe('$async', function(){
+  this.timeout(60000);
+  var dict;
+  beforeEach(function(){
+    dict = win32ole.client.Dispatch('Scripting.Dictionary');
+    dict.Add('a', 1);
+  });
+  it('settles at once for objects of our own apartment', function(done){
+    settles(dict.$async.Exists('a'), function(value){ assert.strictEqual(value, true); }, done);
+  });
+  it('reads and writes properties by their get_ and put_ names', function(done){
+    dict.$async.put_Item('a', 2).then(function(){
+      return dict.$async.get_Item('a');
+    }).then(function(value){
+      assert.equal(value, 2);
+      assert.equal(dict.get_Item('a'), 2);
+      done();
+    }).catch(done);
+  });
+  it('rejects with the error of the call', function(done){
+    rejects(dict.$async.Add('a', 2), function(e){ assert.ok(e instanceof win32ole.OLEException); }, done);
+  });
+  it('throws right away for names and arguments it can check', function(){
+    assert.throws(function(){ dict.$async.NoSuchMember(); }, win32ole.OLEException);
+    assert.throws(function(){ dict.$async.Add('b'); }, win32ole.OLEException);
+  });
+  it('leaves the names of every object alone', function(){
+    assert.equal(typeof String(dict.$async), 'string');
+    assert.equal(typeof (dict.$async + ''), 'string');
+    assert.strictEqual(dict.$async.then, undefined);
+    assert.strictEqual(dict.$async.hasOwnProperty, Object.prototype.hasOwnProperty);
+  });
+});
+
+describe('apartments', function(){
+  this.timeout(60000);
+  // the promises of these settle from the event loop, so their reactions run through node's callback scope
+  it('places objects on the STA pool', function(done){
+    var dict = win32ole.client.Dispatch('Scripting.Dictionary', {apartment: 'pool'});
+    dict.Add('a', 1); // through the proxy
+    assert.equal(dict.Count, 1);
+    dict.$async.Add('b', 2).then(function(){
+      return dict.$async.Count();
+    }).then(function(count){
+      assert.equal(count, 2);
+      assert.equal(dict.get_Item('b'), 2);
+      done();
+    }).catch(done);
+  });
+  it('keeps objects got from a placed object with it', function(done){
+    var fso = win32ole.client.Dispatch('Scripting.FileSystemObject', {apartment: 'pool'});
+    var folder = fso.GetFolder(__dirname);
+    settles(folder.$async.get_Name(), function(name){ assert.equal(name, 'test'); }, done);
+  });
+  it('passes objects inside arrays to the apartment', function(done){
+    var dict = win32ole.client.Dispatch('Scripting.Dictionary', {apartment: 'pool'});
+    var local = win32ole.client.Dispatch('Scripting.Dictionary');
+    local.Add('x', 1);
+    dict.$async.Add('list', [local, [local]]).then(function(){
+      return dict.$async.get_Item('list');
+    }).then(function(list){
+      assert.equal(list[0].Count, 1);
+      assert.equal(list[1][0].get_Item('x'), 1);
+      done();
+    }).catch(done);
+  });
+  it('creates free threaded objects in the MTA', function(done){
+    var fso = win32ole.client.Dispatch('Scripting.FileSystemObject', {apartment: 'mta'});
+    assert.equal(fso.FileExists(__filename), true);
+    var calls = [];
+    for(var i = 0; i < 8; ++i) calls.push(fso.$async.FileExists(__filename));
+    Promise.all(calls).then(function(results){
+      results.forEach(function(r){ assert.strictEqual(r, true); });
+      done();
+    }).catch(done);
+  });
+  it('rejects unknown apartments', function(){
+    assert.throws(function(){ win32ole.client.Dispatch('Scripting.Dictionary', {apartment: 'elsewhere'}); }, TypeError);
+  });
+});
+
+describe('$async out of process', function(){
+  this.timeout(120000);
+  var xl;
+  before(function(){
+    xl = win32ole.client.Dispatch('Excel.Application');
+    xl.DisplayAlerts = false;
+  });
+  after(function(){
+    xl.Quit();
+  });
+  it('calls on the background thread', function(done){
+    settles(xl.$async.get_Version(), function(version){ assert.equal(version, xl.Version); }, done);
+  });
+  it('returns objects usable from node', function(done){
+    xl.$async.get_Workbooks().then(function(books){
+      var book = books.Add();
+      assert.equal(books.Count, 1);
+      book.Close(false);
+      done();
+    }).catch(done);
+  });
+});
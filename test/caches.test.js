@@ -0,0 +1,125 @@
+var win32ole = require('win32ole');
+win32ole.print('caches.test\n');
+var assert = require('assert');
+var path = require('path');
+var fs = require('fs');
+
+var E_BADPARAMCOUNT = 0x8002000E;
+
+describe('options', function(){
+  it('returns the old value when setting one', function(){
+    assert.equal(win32ole.option('nameCache'), 'object');
+    assert.equal(win32ole.option('nameCache', 'shared'), 'object');
+    assert.equal(win32ole.option('nameCache', 'object'), 'shared');
+    assert.equal(win32ole.option('typedArrays', true), false);
+    assert.equal(win32ole.option('typedArrays', false), true);
+    assert.equal(win32ole.option('stringDedup'), false);
+    assert.equal(win32ole.option('stringCache'), 0);
+  });
+  it('rejects bad values and unknown names', function(){
+    assert.throws(function(){ win32ole.option('nameCache', 'sometimes'); }, TypeError);
+    assert.throws(function(){ win32ole.option('lazyBinding', 1); }, TypeError);
+    assert.throws(function(){ win32ole.option('stringCache', -1); }, TypeError);
+    assert.throws(function(){ win32ole.option('noSuchOption'); }, Error);
+  });
+});
+
+describe('type cache', function(){
+  it('writes an index of the type libraries used', function(){
+    // before anything else of scrrun.dll is used in this process
+    var dir = path.join(__dirname, 'tmp', 'typeindex');
+    if(!fs.existsSync(dir)) fs.mkdirSync(dir);
+    var indexed = win32ole.stats().typeCache.indexed;
+    win32ole.option('typeIndex', dir);
+    try{
+      var fso = win32ole.client.Dispatch('Scripting.FileSystemObject');
+      assert.equal(fso.FileExists(__filename), true);
+    }finally{
+      win32ole.option('typeIndex', '');
+    }
+    assert.ok(fs.readdirSync(dir).length > 0);
+    assert.ok(win32ole.stats().typeCache.indexed > indexed); // the members were read from it
+  });
+  it('shares member tables between objects of one type', function(){
+    var first = win32ole.client.Dispatch('Scripting.Dictionary');
+    first.Add('a', 1);
+    var before = win32ole.stats().typeCache;
+    var second = win32ole.client.Dispatch('Scripting.Dictionary');
+    second.Add('a', 1);
+    var after = win32ole.stats().typeCache;
+    assert.ok(after.hits > before.hits);
+    assert.equal(after.entries, before.entries);
+  });
+  it('reports every counter', function(){
+    var stats = win32ole.stats();
+    ['hits', 'misses', 'entries', 'indexed'].forEach(function(k){ assert.equal(typeof stats.typeCache[k], 'number'); });
+    ['hits', 'misses', 'shared'].forEach(function(k){ assert.equal(typeof stats.nameCache[k], 'number'); });
+    ['hits', 'misses', 'entries'].forEach(function(k){ assert.equal(typeof stats.stringCache[k], 'number'); });
+  });
+});
+
+describe('members', function(){
+  var dict;
+  beforeEach(function(){
+    dict = win32ole.client.Dispatch('Scripting.Dictionary');
+  });
+  it('hands out the same wrapper for the same member', function(){
+    assert.strictEqual(dict.Add, dict.Add);
+    assert.strictEqual(dict.Item, dict.Item);
+    assert.strictEqual(dict.get_Item, dict.get_Item);
+    assert.notStrictEqual(dict.get_Item, dict.put_Item);
+  });
+  it('matches names in any case', function(){
+    dict.add('k', 1);
+    assert.equal(dict.COUNT, 1);
+    assert.equal(dict.Get_Item('k'), 1);
+  });
+  it('checks the number of arguments before calling', function(){
+    assert.throws(function(){ dict.Add('k'); }, function(e){ return e.code === E_BADPARAMCOUNT; });
+    assert.throws(function(){ dict.Add('k', 1, 2); }, function(e){ return e.code === E_BADPARAMCOUNT; });
+    assert.equal(dict.Count, 0); // neither reached the object
+  });
+  it('coerces arguments to the declared types', function(){
+    dict.CompareMode = '1'; // a String for a Long
+    assert.strictEqual(dict.CompareMode, 1);
+  });
+  it('shares short string arguments', function(){
+    var fso = win32ole.client.Dispatch('Scripting.FileSystemObject');
+    win32ole.option('stringCache', 16);
+    try{
+      var before = win32ole.stats().stringCache;
+      for(var i = 0; i < 3; ++i) assert.equal(fso.FolderExists('no such folder'), false);
+      var after = win32ole.stats().stringCache;
+      assert.equal(after.misses, before.misses + 1);
+      assert.equal(after.hits, before.hits + 2);
+    }finally{
+      win32ole.option('stringCache', 0);
+    }
+    assert.equal(win32ole.stats().stringCache.entries, 0);
+  });
+});
+
+describe('typedTemplates', function(){
+  var dict, other;
+  before(function(){
+    win32ole.option('typedTemplates', true);
+    try{
+      dict = win32ole.client.Dispatch('Scripting.Dictionary');
+      other = win32ole.client.Dispatch('Scripting.Dictionary');
+    }finally{
+      win32ole.option('typedTemplates', false);
+    }
+  });
+  it('makes properties accessors and methods functions of the class', function(){
+    assert.equal(typeof dict.Add, 'function');
+    assert.strictEqual(dict.Add, other.Add); // on the shared prototype
+    dict.Add('k', 'v');
+    assert.equal(dict.Count, 1);
+    assert.ok(Object.keys(dict).indexOf('Count') >= 0);
+  });
+  it('matches names as the type library spells them', function(){
+    assert.strictEqual(dict.count, undefined);
+    dict.count = 5; // a plain JS property
+    assert.equal(dict.count, 5);
+  });
+});
@@ -0,0 +1,122 @@
+var win32ole = require('win32ole');
+win32ole.print('calls.test\n');
+var assert = require('assert');
+var path = require('path');
+
+var METHOD = win32ole.dispatch_enum.DISPATCH_METHOD;
+var GET = win32ole.dispatch_enum.DISPATCH_PROPERTYGET;
+var PUT = win32ole.dispatch_enum.DISPATCH_PROPERTYPUT;
+var DISP_E_MEMBERNOTFOUND = 0x80020003;
+var DISP_E_UNKNOWNNAME = 0x80020006;
+
+describe('batch', function(){
+  var dict;
+  beforeEach(function(){
+    dict = win32ole.client.Dispatch('Scripting.Dictionary');
+  });
+  it('runs every call and returns their results in order', function(){
+    var results = win32ole.batch(dict, [
+      ['Add', METHOD, ['a', 1]],
+      ['Add', METHOD, ['b', 'two']],
+      ['Count', GET],
+      ['get_Item', GET, ['b']],
+      ['put_Item', PUT, ['a', 3]],
+      ['_', GET, ['a']],
+      [0, GET, ['a']] // DISPID_VALUE
+    ]);
+    assert.equal(results.length, 7);
+    assert.equal(results[2], 2);
+    assert.equal(results[3], 'two');
+    assert.equal(results[5], 3);
+    assert.equal(results[6], 3);
+  });
+  it('leaves the error of a failed call in its slot', function(){
+    var results = win32ole.batch(dict, [
+      ['Add', METHOD, ['a', 1]],
+      ['Add', METHOD, ['a', 2]], // duplicate key
+      ['NoSuchMember', GET],
+      ['get_Item', PUT, ['a', 3]], // the get half with the put flag
+      ['put_Item', GET, ['a']],
+      'not an operation',
+      ['Count', GET]
+    ]);
+    assert.ok(results[1] instanceof win32ole.OLEException);
+    assert.equal(results[2].code, DISP_E_UNKNOWNNAME);
+    assert.equal(results[3].code, DISP_E_MEMBERNOTFOUND);
+    assert.equal(results[4].code, DISP_E_MEMBERNOTFOUND);
+    assert.ok(results[5] instanceof TypeError);
+    assert.equal(results[6], 1);
+  });
+  it('puts the exception of a throwing getter in the slot', function(){
+    var boom = new Error('boom');
+    var op = ['Add', METHOD];
+    Object.defineProperty(op, 2, { get: function(){ throw boom; } });
+    var args = ['c'];
+    Object.defineProperty(args, 1, { get: function(){ throw boom; } });
+    var results = win32ole.batch(dict, [op, ['Add', METHOD, args], ['Count', GET]]);
+    assert.strictEqual(results[0], boom);
+    assert.strictEqual(results[1], boom);
+    assert.equal(results[2], 0);
+  });
+});
+
+describe('invoke by DISPID', function(){
+  var dict;
+  beforeEach(function(){
+    dict = win32ole.client.Dispatch('Scripting.Dictionary');
+    dict.Add('a', 1);
+  });
+  it('calls the members win32ole.typeLibrary describes', function(){
+    var types = win32ole.typeLibrary(dict).types.filter(function(t){ return t.name === 'IDictionary'; });
+    assert.equal(types.length, 1);
+    var count = types[0].members.filter(function(m){ return m.name === 'Count'; })[0];
+    assert.equal(win32ole.invoke(dict, count.dispid, GET, null), 1);
+  });
+  it('calls members by the DISPID $dispid tells', function(){
+    var id = dict.$dispid('Count');
+    assert.equal(typeof id, 'number');
+    assert.equal(dict.$invoke(id, GET), 1);
+    assert.equal(win32ole.invoke(dict, id, GET, null), 1);
+    assert.equal(dict.$invoke(dict.$dispid('Exists'), METHOD, 'a'), true);
+    assert.throws(function(){ dict.$dispid('NoSuchMember'); }, function(e){ return e.code === DISP_E_UNKNOWNNAME; });
+  });
+});
+
+describe('compile', function(){
+  var dict, fso;
+  before(function(){
+    dict = win32ole.client.Dispatch('Scripting.Dictionary');
+    dict.Add('a', 1);
+    fso = win32ole.client.Dispatch('Scripting.FileSystemObject');
+  });
+  it('reads and writes a member through a path', function(){
+    var item = win32ole.compile(dict, 'Item(?)');
+    assert.equal(item(dict, 'a'), 1);
+    item(dict, 'a', 2); // one argument more assigns
+    assert.equal(dict.get_Item('a'), 2);
+  });
+  it('walks objects in between without returning them', function(){
+    var nameOf = win32ole.compile(fso, 'GetFile(?).Name');
+    assert.equal(nameOf(fso, __filename), path.basename(__filename));
+    var sizeOf = win32ole.compile(fso, 'GetFile(?).ParentFolder.Files.Count');
+    assert.equal(sizeOf(fso, __filename), fso.GetFolder(__dirname).Files.Count);
+  });
+  it('runs on other objects of the type it was compiled with', function(){
+    var count = win32ole.compile(dict, 'Count');
+    var other = win32ole.client.Dispatch('Scripting.Dictionary');
+    assert.equal(count(other), 0);
+    other.Add('x', 1);
+    assert.equal(count(other), 1);
+  });
+  it('looks names up again on objects of another type', function(){
+    var count = win32ole.compile(dict, 'Count');
+    var drives = fso.Drives;
+    assert.equal(count(drives), drives.Count);
+    var exists = win32ole.compile(dict, 'Exists(?)'); // no Exists on a Drives collection
+    assert.throws(function(){ exists(drives, 'C:'); }, win32ole.OLEException);
+  });
+  it('rejects paths it can not bind', function(){
+    assert.throws(function(){ win32ole.compile(dict, 'NoSuchMember'); }, Error);
+    assert.throws(function(){ win32ole.compile(dict, 'Item(?'); }, Error);
+  });
+});
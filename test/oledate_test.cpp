@@ -0,0 +1,110 @@
+/*
+  oledate_test.cpp
+  Checks src/oledate against reference values, without node or Windows:
+    nmake oledate_test
+    g++ -Isrc test/oledate_test.cpp src/oledate.cpp -o oledate_test && ./oledate_test
+*/
+
+#include "oledate.h"
+#include <cstdio>
+
+using namespace ole32core;
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char* what, double got, double expected)
+{
+  if (ok) return;
+  ++failures;
+  printf("FAILED %s: got %.6f, expected %.6f\n", what, got, expected);
+}
+
+void equal(const char* what, double got, double expected)
+{
+  check(std::fabs(got - expected) < 1e-9, what, got, expected);
+}
+
+// A zone one hour east of UTC, two from 2024-03-31 01:00 UTC to 2024-10-27 01:00 UTC
+const double DST_START = 1711846800.0;
+const double DST_END = 1729990800.0;
+int offsetCalls = 0;
+
+long FakeOffset(double utcSec)
+{
+  ++offsetCalls;
+  return utcSec >= DST_START && utcSec < DST_END ? 7200 : 3600;
+}
+
+void testDates()
+{
+  // OLE date, wall clock ms since 1970-01-01
+  struct { double date; double ms; const char* what; } pairs[] = {
+    { 25569.0, 0.0, "1970-01-01" },
+    { 0.0, -2209161600000.0, "1899-12-30" },
+    { 2.5, -2208945600000.0, "1900-01-01 12:00" },
+    { 45292.5, 1704110400000.0, "2024-01-01 12:00" },
+    { -1.25, -2209226400000.0, "1899-12-29 06:00 (-1.25)" },
+    { -1.5, -2209204800000.0, "1899-12-29 12:00 (-1.5)" },
+    { -2.75, -2209269600000.0, "1899-12-28 18:00 (-2.75)" },
+    { -1.0, -2209248000000.0, "1899-12-29" },
+  };
+  for (size_t i = 0; i < sizeof(pairs) / sizeof(pairs[0]); ++i)
+  {
+    equal(pairs[i].what, OleDateToMs(pairs[i].date), pairs[i].ms);
+    equal(pairs[i].what, MsToOleDate(pairs[i].ms), pairs[i].date);
+  }
+
+  // milliseconds survive the double the OLE date is
+  double ms[] = { 1700000000123.0, 1.0, -1.0, 253402300799999.0, -2209226400001.0, -62135596800000.0 };
+  for (size_t i = 0; i < sizeof(ms) / sizeof(ms[0]); ++i)
+  {
+    equal("round trip", OleDateToMs(MsToOleDate(ms[i])), ms[i]);
+  }
+
+  double dates[] = { 25569.0, -1.25, 45292.5 };
+  double out[3];
+  OleDatesToMs(dates, out, 3);
+  equal("array kernel", out[1], -2209226400000.0);
+}
+
+void testOffsets()
+{
+  OCLocalTime local(FakeOffset);
+  double start = DST_START * 1000, end = DST_END * 1000;
+  equal("before DST", local.offsetMs(start - 1000), 3600000.0);
+  equal("DST starts", local.offsetMs(start), 7200000.0);
+  equal("last DST second", local.offsetMs(end - 1000), 7200000.0);
+  equal("DST ends", local.offsetMs(end), 3600000.0);
+  equal("to local", local.toLocal(start), start + 7200000.0);
+
+  // 02:30 local doesn't exist on 2024-03-31, 02:30 happens twice on 2024-10-27
+  double skipped = start + 3600000.0 + 1800000.0;
+  equal("skipped local time", local.toUtc(skipped), skipped - 3600000.0);
+  double repeated = end + 5400000.0;
+  equal("repeated local time", local.toUtc(repeated), repeated - 3600000.0); // the later one
+  equal("summer local time", local.toUtc(start + 86400000.0 + 7200000.0), start + 86400000.0);
+
+  // the periods of the table hold the offsets, later lookups in them don't ask again
+  size_t periods = local.periods();
+  check(periods == 3, "periods", (double)periods, 3);
+  int calls = offsetCalls;
+  for (double t = start; t < end; t += 3600000.0) local.offsetMs(t);
+  check(offsetCalls == calls, "offset calls within a period", offsetCalls, calls);
+  check(local.periods() == periods, "periods after lookups", (double)local.periods(), (double)periods);
+
+  // NaN (an invalid Date) has no offset
+  double nan = 0.0 / 0.0;
+  check(local.offsetMs(nan) == 0, "NaN offset", local.offsetMs(nan), 0);
+}
+
+} // namespace
+
+int main()
+{
+  testDates();
+  testOffsets();
+  printf("oledate_test %s\n", failures ? "failed" : "passed");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,176 @@
+var win32ole = require('win32ole');
+win32ole.print('variant.test\n');
+var assert = require('assert');
+
+function roundTrip(value){
+  var dict = win32ole.client.Dispatch('Scripting.Dictionary');
+  dict.Add('k', value);
+  return dict.get_Item('k');
+}
+
+function withOption(name, value, fn){
+  var saved = win32ole.option(name, value);
+  try{
+    return fn();
+  }finally{
+    win32ole.option(name, saved);
+  }
+}
+
+describe('arrays', function(){
+  it('passes nested arrays as one multidimensional SAFEARRAY', function(){
+    var cube = [];
+    for(var i = 0; i < 2; ++i){
+      cube.push([]);
+      for(var j = 0; j < 3; ++j){
+        cube[i].push([]);
+        for(var k = 0; k < 4; ++k) cube[i][j].push(i * 100 + j * 10 + k);
+      }
+    }
+    assert.deepEqual(roundTrip(cube), cube);
+    var grid = [[0.5, 1], [2, 3.25]];
+    assert.deepEqual(roundTrip(grid), grid);
+    var names = [['a', 'b'], ['c', 'd\u0000e']]; // BSTRs are read by length
+    assert.deepEqual(roundTrip(names), names);
+  });
+  it('passes ragged and mixed arrays as arrays of Variants', function(){
+    var ragged = [[1], [2, 3], []];
+    assert.deepEqual(roundTrip(ragged), ragged);
+    var mixed = [1, 2.5, 'x', true, [4, 'y']];
+    assert.deepEqual(roundTrip(mixed), mixed);
+    assert.deepEqual(roundTrip([]), []);
+  });
+  it('fails cleanly when a getter changes or breaks the array', function(){
+    var dict = win32ole.client.Dispatch('Scripting.Dictionary');
+    var reads = 0;
+    var changing = [1, 2, 3];
+    Object.defineProperty(changing, 1, { get: function(){ return ++reads > 1 ? 'two' : 2; } });
+    assert.throws(function(){ dict.Add('a', changing); }, TypeError);
+    var boom = new Error('boom');
+    var throwing = [[1, 2], [3, 4]];
+    Object.defineProperty(throwing[1], 0, { get: function(){ throw boom; } });
+    assert.throws(function(){ dict.Add('b', throwing); }, function(e){ return e === boom; });
+    assert.equal(dict.Count, 0);
+  });
+});
+
+describe('typed arrays', function(){
+  it('passes TypedArrays and Buffers as arrays of their element type', function(){
+    assert.deepEqual(roundTrip(new Float64Array([1.5, -2.5, 1e300])), [1.5, -2.5, 1e300]);
+    assert.deepEqual(roundTrip(new Int32Array([1, -2, 0x7fffffff])), [1, -2, 0x7fffffff]);
+    assert.deepEqual(roundTrip(Buffer.from([0, 1, 255])), [0, 1, 255]);
+  });
+  it('returns one-dimensional numeric arrays as TypedArrays with typedArrays', function(){
+    withOption('typedArrays', true, function(){
+      var doubles = roundTrip(new Float64Array([1.5, -2.5]));
+      assert.ok(doubles instanceof Float64Array);
+      assert.deepEqual(Array.prototype.slice.call(doubles), [1.5, -2.5]);
+      var ints = roundTrip([1, 2, 3]); // Long elements
+      assert.ok(ints instanceof Int32Array);
+      assert.equal(ints[2], 3);
+      var bytes = roundTrip(Buffer.from('abc'));
+      assert.ok(Buffer.isBuffer(bytes));
+      assert.equal(bytes.toString(), 'abc');
+      assert.ok(Array.isArray(roundTrip([[1, 2], [3, 4]]))); // only one dimension
+      assert.ok(Array.isArray(roundTrip([1, 'x'])));
+    });
+  });
+  it('reads binary streams into Buffers', function(){
+    var data = Buffer.from([0x4e, 0x00, 0x55, 0x4c, 0xff]);
+    var stream = win32ole.client.Dispatch('ADODB.Stream');
+    stream.Type = 1; // adTypeBinary
+    stream.Open();
+    try{
+      stream.Write(data);
+      stream.Position = 0;
+      var read = withOption('typedArrays', true, function(){ return stream.Read(); });
+      assert.ok(Buffer.isBuffer(read));
+      assert.ok(read.equals(data));
+    }finally{
+      stream.Close();
+    }
+  });
+});
+
+describe('strings', function(){
+  it('keeps embedded NULs', function(){
+    assert.strictEqual(roundTrip('a\u0000b\u0000'), 'a\u0000b\u0000');
+    assert.strictEqual(roundTrip(''), '');
+  });
+  it('converts long strings', function(){
+    var long = new Array(50001).join('x') + 'é漢';
+    assert.strictEqual(roundTrip(long), long);
+  });
+  it('converts Latin-1 and other characters', function(){
+    ['plain ascii', 'café ÿ ', '森鷗外𠮟る'].forEach(function(s){
+      assert.strictEqual(roundTrip(s), s);
+    });
+  });
+  it('reads equal strings of an array with stringDedup', function(){
+    var column = [];
+    for(var i = 0; i < 100; ++i) column.push(['open', 'closed', 'café'][i % 3]);
+    var read = withOption('stringDedup', true, function(){ return roundTrip(column); });
+    assert.deepEqual(read, column);
+  });
+});
+
+describe('dates', function(){
+  it('keeps milliseconds', function(){
+    var date = new Date(2024, 0, 15, 10, 20, 30, 456);
+    var read = roundTrip(date);
+    assert.ok(read instanceof Date);
+    assert.equal(read.getTime(), date.getTime());
+  });
+  it('converts dates before 1899-12-30', function(){
+    var date = new Date(1899, 11, 29, 6, 0, 0); // OLE date -1.25
+    assert.equal(roundTrip(date).getTime(), date.getTime());
+  });
+  it('converts dates in arrays', function(){
+    var dates = [new Date(2024, 2, 31, 12), new Date(2024, 9, 27, 12), new Date(2000, 0, 1, 0, 0, 0, 1)];
+    var read = roundTrip(dates);
+    for(var i = 0; i < dates.length; ++i) assert.equal(read[i].getTime(), dates[i].getTime());
+  });
+  it('rejects invalid dates', function(){
+    assert.throws(function(){ roundTrip(new Date(NaN)); }, TypeError);
+  });
+});
+
+describe('Excel ranges', function(){
+  this.timeout(120000);
+  var xl, book, sheet;
+  before(function(){
+    xl = win32ole.client.Dispatch('Excel.Application');
+    xl.DisplayAlerts = false;
+    book = xl.Workbooks.Add();
+    sheet = book.Worksheets(1);
+  });
+  after(function(){
+    book.Close(false);
+    xl.Quit();
+  });
+  it('reads a Range.Value2 into nested arrays of its rows', function(){
+    for(var r = 1; r <= 3; ++r){
+      sheet.Cells(r, 1).Value = r * 10;
+      sheet.Cells(r, 2).Value = r + 0.5;
+      sheet.Cells(r, 3).Value = 'row ' + r;
+    }
+    assert.deepEqual(sheet.Range('A1:C3').Value2, [[10, 1.5, 'row 1'], [20, 2.5, 'row 2'], [30, 3.5, 'row 3']]);
+    assert.deepEqual(sheet.Range('B2:B3').Value2, [[2.5], [3.5]]); // still two dimensions
+  });
+  it('writes a Range.Value in one call', function(){
+    var rows = [];
+    for(var r = 0; r < 100; ++r) rows.push([r, r * 0.5, 'row ' + r]);
+    sheet.Range('A11:C110').Value = rows;
+    assert.equal(sheet.Cells(61, 3).Value2, 'row 50');
+    assert.deepEqual(sheet.Range('A11:C110').Value2, rows);
+  });
+  it('reads ranges into nested arrays with typedArrays', function(){
+    sheet.Range('E1:F2').Value = [[1, 2], [3, 4]];
+    var read = withOption('typedArrays', true, function(){ return sheet.Range('E1:F2').Value2; });
+    assert.deepEqual(read, [[1, 2], [3, 4]]);
+  });
+  it('stores dates as OLE dates', function(){
+    sheet.Cells(1, 8).Value = new Date(2024, 0, 1, 12, 0, 0);
+    assert.equal(sheet.Cells(1, 8).Value2, 45292.5);
+  });
+});